@@ -15,6 +15,64 @@ extern "C" {
 #include "com_baidu_hugegraph_util_collection_JniLongSetIterator.h"
 }
 
+// containsBatch 的结果直接作为 jboolean 数组写回
+static_assert(sizeof(jboolean) == sizeof(bool), "jboolean should be bool");
+
+// 数组按段复制到栈上处理的个数
+const int JNI_SLICE_LEN = 1024;
+
+// 按段复制 values[off, off + len) 到栈上并调用 fn(p, n, i)，i 为段在
+// [0, len) 中的起点，返回 fn 的结果之和。整批操作不在 critical 区内执行，
+// 不会长时间阻塞 GC（off/len 已在 java 中检查）
+template <class F>
+static jint forEachSlice(JNIEnv *env, jlongArray values, jint off, jint len,
+                         F fn) {
+  jlong buf[JNI_SLICE_LEN];
+  size_t n = 0;
+  for (jint i = 0; i < len; i += JNI_SLICE_LEN) {
+    jint m = std::min(len - i, (jint)JNI_SLICE_LEN);
+    env->GetLongArrayRegion(values, off + i, m, buf);
+    if (env->ExceptionCheck()) {
+      return -1;
+    }
+    n += fn((int64_t *)buf, m, i);
+  }
+  return (jint)n;
+}
+
+// 与 NativeReference.MEM_* 的顺序一致
+static void toMemoryFields(const fastset::MemoryUsage &usage, jlong *p) {
+  p[0] = usage.total();
+  p[1] = usage.nodeTable;
+  p[2] = usage.dataChunks;
+  p[3] = usage.freeLists;
+  p[4] = usage.wastedTail;
+  p[5] = usage.overhead;
+  p[6] = usage.mapped;
+}
+
+// out 依次为整个集合及各分区的 MEM_FIELDS 项（长度不足时只写入前面的部分），
+// 为空时只返回分区数
+template <class Set>
+static jint getMemoryUsage(JNIEnv *env, Set *set, jlongArray out) {
+  const int FIELDS = 7;
+  std::vector<fastset::MemoryUsage> parts;
+  set->memoryUsage(parts);
+  int partitions = (int)parts.size();
+  if (out == NULL) {
+    return partitions;
+  }
+  int len = env->GetArrayLength(out);
+  std::vector<jlong> fields((partitions + 1) * FIELDS);
+  toMemoryFields(set->memoryUsage(), &fields[0]);
+  for (int i = 0; i < partitions; i++) {
+    toMemoryFields(parts[i], &fields[(i + 1) * FIELDS]);
+  }
+  env->SetLongArrayRegion(out, 0, std::min(len, (int)fields.size()),
+                          &fields[0]);
+  return partitions;
+}
+
 /////////////////////////////////////////////////////////////////////////
 // JNILongSet
 /////////////////////////////////////////////////////////////////////////
@@ -73,7 +131,119 @@ Java_com_baidu_hugegraph_util_collection_JniLongSet_addAll(JNIEnv *env,
                                                            jlong src) {
   LongFastset *set = (LongFastset *)ptr;
   LongFastset *srcset = (LongFastset *)src;
-  return (jlong)set->addAll(srcset->begin(), srcset->end());
+  return (jlong)set->addAll(srcset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    addArray
+ * Signature: (J[JII)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_addArray(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray values, jint off,
+    jint len) {
+  LongFastset *set = (LongFastset *)ptr;
+  return forEachSlice(env, values, off, len,
+                      [set](int64_t *p, jint n, jint i) {
+                        return set->addBatch(p, n);
+                      });
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    removeArray
+ * Signature: (J[JII)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_removeArray(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray values, jint off,
+    jint len) {
+  LongFastset *set = (LongFastset *)ptr;
+  return forEachSlice(env, values, off, len,
+                      [set](int64_t *p, jint n, jint i) {
+                        return set->removeBatch(p, n);
+                      });
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    containsArray
+ * Signature: (J[JII[Z)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_containsArray(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray values, jint off,
+    jint len, jbooleanArray out) {
+  LongFastset *set = (LongFastset *)ptr;
+  bool r[JNI_SLICE_LEN];
+  return forEachSlice(env, values, off, len,
+                      [env, set, out, &r](int64_t *p, jint n, jint i) {
+                        if (out == NULL) {
+                          return set->containsBatch(p, n);
+                        }
+                        size_t c = set->containsBatch(p, n, r);
+                        env->SetBooleanArrayRegion(out, i, n, (jboolean *)r);
+                        return c;
+                      });
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    addBuffer
+ * Signature: (JLjava/nio/ByteBuffer;II)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_addBuffer(
+    JNIEnv *env, jobject obj, jlong ptr, jobject values, jint off, jint len) {
+  LongFastset *set = (LongFastset *)ptr;
+  // direct buffer，按本机字节序存放的 long。off/len 以 long 为单位
+  int64_t *p = (int64_t *)env->GetDirectBufferAddress(values);
+  if (p == NULL) {
+    return -1;
+  }
+  return (jint)set->addBatch(p + off, len);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    containsBuffer
+ * Signature: (JLjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_containsBuffer(
+    JNIEnv *env, jobject obj, jlong ptr, jobject values, jint off, jint len,
+    jobject out) {
+  LongFastset *set = (LongFastset *)ptr;
+  // 结果写入 out 的位图中：第 i 个数据存在时，第 i 位为 1
+  int64_t *p = (int64_t *)env->GetDirectBufferAddress(values);
+  unsigned char *bitmap = NULL;
+  if (out != NULL) {
+    bitmap = (unsigned char *)env->GetDirectBufferAddress(out);
+  }
+  if (p == NULL || (out != NULL && bitmap == NULL)) {
+    return -1;
+  }
+
+  const int BATCH = 1024;
+  bool results[BATCH];
+  size_t n = 0;
+  for (int i = 0; i < len; i += BATCH) {
+    int count = len - i < BATCH ? len - i : BATCH;
+    n += set->containsBatch(p + off + i, count, results);
+    if (bitmap == NULL) {
+      continue;
+    }
+    for (int k = 0; k < count; k++) {
+      int bit = i + k;
+      if (results[k]) {
+        bitmap[bit >> 3] |= 1 << (bit & 7);
+      } else {
+        bitmap[bit >> 3] &= ~(1 << (bit & 7));
+      }
+    }
+  }
+  return (jint)n;
 }
 
 /*
@@ -89,6 +259,85 @@ Java_com_baidu_hugegraph_util_collection_JniLongSet_addExclusive(
   return (jlong)set->addExclusive(value, otherset);
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    intersectWith
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_intersectWith(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *otherset = (LongFastset *)other;
+  return (jlong)set->intersectWith(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    subtract
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_subtract(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *otherset = (LongFastset *)other;
+  return (jlong)set->subtract(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    symmetricDifference
+ * Signature: (JJJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_symmetricDifference(
+    JNIEnv *env, jobject obj, jlong ptr, jlong a, jlong b) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *aset = (LongFastset *)a;
+  LongFastset *bset = (LongFastset *)b;
+  return (jlong)set->symmetricDifference(aset, bset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    intersectionSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_intersectionSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *otherset = (LongFastset *)other;
+  return (jlong)set->intersectionSize(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    differenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_differenceSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *otherset = (LongFastset *)other;
+  return (jlong)set->differenceSize(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    symmetricDifferenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_symmetricDifferenceSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  LongFastset *set = (LongFastset *)ptr;
+  LongFastset *otherset = (LongFastset *)other;
+  return (jlong)set->symmetricDifferenceSize(otherset);
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSet
  * Method:    contains
@@ -146,6 +395,45 @@ Java_com_baidu_hugegraph_util_collection_JniLongSet_size(JNIEnv *env,
   return set->size();
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    reserve
+ * Signature: (JJ)V
+ */
+JNIEXPORT void JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_reserve(
+    JNIEnv *env, jobject obj, jlong ptr, jlong expectedCount) {
+  LongFastset *set = (LongFastset *)ptr;
+  if (expectedCount > 0) {
+    set->reserve(expectedCount);
+  }
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    compact
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_compact(JNIEnv *env,
+                                                            jobject obj,
+                                                            jlong ptr) {
+  LongFastset *set = (LongFastset *)ptr;
+  return set->compact();
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    memoryUsage
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSet_memoryUsage(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray out) {
+  LongFastset *set = (LongFastset *)ptr;
+  return getMemoryUsage(env, set, out);
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSet
  * Method:    clear
@@ -199,6 +487,32 @@ Java_com_baidu_hugegraph_util_collection_JniLongSetIterator_next(JNIEnv *env,
   return *it++;
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSetIterator
+ * Method:    nextBatch
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniLongSetIterator_nextBatch(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray out) {
+  LongFastset_iterator &it = *(LongFastset_iterator *)ptr;
+  // 尽可能填满 out，返回填入的个数（为 0 表示迭代结束）。
+  // 按段填到栈上再复制，迭代不在 critical 区内执行
+  int len = env->GetArrayLength(out);
+  jlong buf[JNI_SLICE_LEN];
+  int n = 0;
+  while (n < len && it.isValid()) {
+    int limit = std::min(len - n, JNI_SLICE_LEN);
+    int m = 0;
+    while (m < limit && it.isValid()) {
+      buf[m++] = *it++;
+    }
+    env->SetLongArrayRegion(out, n, m, buf);
+    n += m;
+  }
+  return n;
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSetIterator
  * Method:    deleteNative
@@ -296,6 +610,85 @@ Java_com_baidu_hugegraph_util_collection_JniBytesSet_addExclusive(
   return ret;
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    intersectWith
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_intersectWith(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *otherset = (SliceFastset *)other;
+  return (jlong)set->intersectWith(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    subtract
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_subtract(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *otherset = (SliceFastset *)other;
+  return (jlong)set->subtract(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    symmetricDifference
+ * Signature: (JJJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_symmetricDifference(
+    JNIEnv *env, jobject obj, jlong ptr, jlong a, jlong b) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *aset = (SliceFastset *)a;
+  SliceFastset *bset = (SliceFastset *)b;
+  return (jlong)set->symmetricDifference(aset, bset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    intersectionSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_intersectionSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *otherset = (SliceFastset *)other;
+  return (jlong)set->intersectionSize(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    differenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_differenceSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *otherset = (SliceFastset *)other;
+  return (jlong)set->differenceSize(otherset);
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    symmetricDifferenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_symmetricDifferenceSize(
+    JNIEnv *env, jobject obj, jlong ptr, jlong other) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  SliceFastset *otherset = (SliceFastset *)other;
+  return (jlong)set->symmetricDifferenceSize(otherset);
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
  * Method:    contains
@@ -362,6 +755,45 @@ Java_com_baidu_hugegraph_util_collection_JniBytesSet_size(JNIEnv *env,
   return set->size();
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    reserve
+ * Signature: (JJ)V
+ */
+JNIEXPORT void JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_reserve(
+    JNIEnv *env, jobject obj, jlong ptr, jlong expectedCount) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  if (expectedCount > 0) {
+    set->reserve(expectedCount);
+  }
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    compact
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_compact(JNIEnv *env,
+                                                             jobject obj,
+                                                             jlong ptr) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  return set->compact();
+}
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    memoryUsage
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSet_memoryUsage(
+    JNIEnv *env, jobject obj, jlong ptr, jlongArray out) {
+  SliceFastset *set = (SliceFastset *)ptr;
+  return getMemoryUsage(env, set, out);
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
  * Method:    clear
@@ -417,6 +849,39 @@ Java_com_baidu_hugegraph_util_collection_JniBytesSetIterator_next(JNIEnv *env,
   return result;
 }
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSetIterator
+ * Method:    nextBatch
+ * Signature: (JLjava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL
+Java_com_baidu_hugegraph_util_collection_JniBytesSetIterator_nextBatch(
+    JNIEnv *env, jobject obj, jlong ptr, jobject out) {
+  SliceFastset_iterator &it = *(SliceFastset_iterator *)ptr;
+  // 依次写入 [int32 长度（本机字节序）][数据]，直到 out 放不下下一项。
+  // 返回写入的个数；迭代结束返回 0，out 放不下一项时返回 -1
+  unsigned char *p = (unsigned char *)env->GetDirectBufferAddress(out);
+  jlong capacity = env->GetDirectBufferCapacity(out);
+  if (p == NULL) {
+    return -1;
+  }
+  jlong used = 0;
+  int n = 0;
+  while (it.isValid()) {
+    Slice slice = *it;
+    if (used + (jlong)sizeof(int32_t) + slice.len > capacity) {
+      return n > 0 ? n : -1;
+    }
+    int32_t len = slice.len;
+    memcpy(p + used, &len, sizeof(len));
+    memcpy(p + used + sizeof(len), slice.buf, len);
+    used += sizeof(len) + len;
+    ++it;
+    n++;
+  }
+  return n;
+}
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSetIterator
  * Method:    deleteNative
@@ -39,6 +39,54 @@ JNIEXPORT jboolean JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_
 JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_addAll
   (JNIEnv *, jobject, jlong, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    intersectWith
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_intersectWith
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    subtract
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_subtract
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    symmetricDifference
+ * Signature: (JJJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_symmetricDifference
+  (JNIEnv *, jobject, jlong, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    intersectionSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_intersectionSize
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    differenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_differenceSize
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    symmetricDifferenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_symmetricDifferenceSize
+  (JNIEnv *, jobject, jlong, jlong);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
  * Method:    contains
@@ -71,6 +119,30 @@ JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_eras
 JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_size
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    reserve
+ * Signature: (JJ)V
+ */
+JNIEXPORT void JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_reserve
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    compact
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_compact
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
+ * Method:    memoryUsage
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSet_memoryUsage
+  (JNIEnv *, jobject, jlong, jlongArray);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSet
  * Method:    clear
@@ -23,6 +23,14 @@ JNIEXPORT jbyteArray JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSe
 JNIEXPORT jboolean JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSetIterator_hasNext
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniBytesSetIterator
+ * Method:    nextBatch
+ * Signature: (JLjava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniBytesSetIterator_nextBatch
+  (JNIEnv *, jobject, jlong, jobject);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniBytesSetIterator
  * Method:    deleteNative
@@ -39,6 +39,94 @@ JNIEXPORT jboolean JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_a
 JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_addAll
   (JNIEnv *, jobject, jlong, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    intersectWith
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_intersectWith
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    subtract
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_subtract
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    symmetricDifference
+ * Signature: (JJJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_symmetricDifference
+  (JNIEnv *, jobject, jlong, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    intersectionSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_intersectionSize
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    differenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_differenceSize
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    symmetricDifferenceSize
+ * Signature: (JJ)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_symmetricDifferenceSize
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    addArray
+ * Signature: (J[JII)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_addArray
+  (JNIEnv *, jobject, jlong, jlongArray, jint, jint);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    removeArray
+ * Signature: (J[JII)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_removeArray
+  (JNIEnv *, jobject, jlong, jlongArray, jint, jint);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    containsArray
+ * Signature: (J[JII[Z)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_containsArray
+  (JNIEnv *, jobject, jlong, jlongArray, jint, jint, jbooleanArray);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    addBuffer
+ * Signature: (JLjava/nio/ByteBuffer;II)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_addBuffer
+  (JNIEnv *, jobject, jlong, jobject, jint, jint);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    containsBuffer
+ * Signature: (JLjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_containsBuffer
+  (JNIEnv *, jobject, jlong, jobject, jint, jint, jobject);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSet
  * Method:    contains
@@ -71,6 +159,30 @@ JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_erase
 JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_size
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    reserve
+ * Signature: (JJ)V
+ */
+JNIEXPORT void JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_reserve
+  (JNIEnv *, jobject, jlong, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    compact
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_compact
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSet
+ * Method:    memoryUsage
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSet_memoryUsage
+  (JNIEnv *, jobject, jlong, jlongArray);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSet
  * Method:    clear
@@ -23,6 +23,14 @@ JNIEXPORT jlong JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSetItera
 JNIEXPORT jboolean JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSetIterator_hasNext
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     com_baidu_hugegraph_util_collection_JniLongSetIterator
+ * Method:    nextBatch
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL Java_com_baidu_hugegraph_util_collection_JniLongSetIterator_nextBatch
+  (JNIEnv *, jobject, jlong, jlongArray);
+
 /*
  * Class:     com_baidu_hugegraph_util_collection_JniLongSetIterator
  * Method:    deleteNative
@@ -25,6 +25,56 @@ public class JniBytesSet extends NativeReference implements Iterable<byte[]> {
         return addExclusive(handle, value, other.handle);
     }
 
+    private native long intersectWith(long handle, long other);
+
+    /**
+     * Keeps only the values also in other, returns the number removed.
+     * Lookups reuse the hash codes stored in the nodes.
+     */
+    public long intersectWith(JniBytesSet other) {
+        return intersectWith(handle, other.handle);
+    }
+
+    private native long subtract(long handle, long other);
+
+    /**
+     * Removes the values also in other, returns the number removed.
+     */
+    public long subtract(JniBytesSet other) {
+        return subtract(handle, other.handle);
+    }
+
+    private native long symmetricDifference(long handle, long a, long b);
+
+    /**
+     * Adds the values in exactly one of a and b, returns the number added.
+     * When this set is a (or b) the result replaces its contents.
+     */
+    public long symmetricDifference(JniBytesSet a, JniBytesSet b) {
+        return symmetricDifference(handle, a.handle, b.handle);
+    }
+
+    private native long intersectionSize(long handle, long other);
+
+    public long intersectionSize(JniBytesSet other) {
+        return intersectionSize(handle, other.handle);
+    }
+
+    private native long differenceSize(long handle, long other);
+
+    /**
+     * Returns the number of values in this set but not in other.
+     */
+    public long differenceSize(JniBytesSet other) {
+        return differenceSize(handle, other.handle);
+    }
+
+    private native long symmetricDifferenceSize(long handle, long other);
+
+    public long symmetricDifferenceSize(JniBytesSet other) {
+        return symmetricDifferenceSize(handle, other.handle);
+    }
+
     private native boolean remove(long handle, byte[] value);
 
     public boolean remove(byte[] value) {
@@ -49,6 +99,50 @@ public class JniBytesSet extends NativeReference implements Iterable<byte[]> {
         return handle != 0 ? size(handle) : 0;
     }
 
+    private native void reserve(long handle, long expectedCount);
+
+    /**
+     * Pre-sizes every partition for expectedCount values so that later adds
+     * do not pay for repeated doublings. Must not run concurrently with
+     * other modifications.
+     */
+    public void reserve(long expectedCount) {
+        reserve(handle, expectedCount);
+    }
+
+    private native long compact(long handle);
+
+    /**
+     * Shrinks partitions that became sparse after removals and returns the
+     * freed native memory in bytes. Must not run concurrently with other
+     * operations on the set.
+     */
+    public long compact() {
+        return handle != 0 ? compact(handle) : 0;
+    }
+
+    private native int memoryUsage(long handle, long[] out);
+
+    /**
+     * Returns the bytes of native memory held by the set.
+     */
+    public long memoryUsage() {
+        long[] usage = new long[MEM_FIELDS];
+        memoryUsage(handle, usage);
+        return usage[MEM_TOTAL];
+    }
+
+    /**
+     * Returns the native memory of each partition, indexed by the MEM_*
+     * fields. Memory mapped from a snapshot belongs to no partition.
+     */
+    public long[][] memoryUsageByPartition() {
+        int partitions = memoryUsage(handle, null);
+        long[] usage = new long[(partitions + 1) * MEM_FIELDS];
+        memoryUsage(handle, usage);
+        return splitMemoryUsage(usage, partitions);
+    }
+
     private native void clear(long handle);
 
     public void clear() {
@@ -1,5 +1,6 @@
 package com.baidu.hugegraph.util.collection;
 
+import java.nio.ByteBuffer;
 import java.util.Iterator;
 
 public class JniBytesSetIterator extends NativeReference implements Iterator<byte[]> {
@@ -21,6 +22,27 @@ public class JniBytesSetIterator extends NativeReference implements Iterator<byt
         }
         throw new NullPointerException();
     }
+    private native int nextBatch(long handle, ByteBuffer out);
+
+    /**
+     * Packs as many values as fit into the direct buffer out, each one as an
+     * int length in native byte order followed by its bytes. Returns the
+     * number of values packed (0 when the iteration is finished).
+     */
+    public int nextBatch(ByteBuffer out) {
+        if (handle == 0) {
+            throw new NullPointerException();
+        }
+        if (!out.isDirect()) {
+            throw new IllegalArgumentException("out should be a direct buffer");
+        }
+        int n = nextBatch(handle, out);
+        if (n < 0) {
+            throw new IllegalArgumentException("out is too small for next value");
+        }
+        return n;
+    }
+
     @Override
     public void close() {
         if (handle != 0) {
@@ -1,5 +1,7 @@
 package com.baidu.hugegraph.util.collection;
 
+import java.nio.ByteBuffer;
+
 public class JniLongSet extends NativeReference  implements Iterable<Long> {
     long handle;
 
@@ -19,12 +21,153 @@ public class JniLongSet extends NativeReference  implements Iterable<Long> {
         return addAll(handle, other.handle);
     }
 
+    private native int addArray(long handle, long[] values, int off, int len);
+
+    /**
+     * Adds values[off, off + len) with one JNI call, returns the number of
+     * values actually added.
+     */
+    public int addAll(long[] values, int off, int len) {
+        checkRange(values.length, off, len);
+        return addArray(handle, values, off, len);
+    }
+
+    public int addAll(long[] values) {
+        return addAll(values, 0, values.length);
+    }
+
+    private native int removeArray(long handle, long[] values, int off, int len);
+
+    /**
+     * Removes values[off, off + len) with one JNI call, returns the number of
+     * values actually removed. Safe to call concurrently with adds, removes
+     * and lookups on a concurrent set.
+     */
+    public int removeAll(long[] values, int off, int len) {
+        checkRange(values.length, off, len);
+        return removeArray(handle, values, off, len);
+    }
+
+    public int removeAll(long[] values) {
+        return removeAll(values, 0, values.length);
+    }
+
+    private native int containsArray(long handle, long[] values, int off, int len, boolean[] out);
+
+    /**
+     * Checks values[off, off + len) with one JNI call. out[i] is set for
+     * values[off + i] if out is not null. Returns the number of values found.
+     */
+    public int containsAll(long[] values, int off, int len, boolean[] out) {
+        checkRange(values.length, off, len);
+        if (out != null && out.length < len) {
+            throw new IndexOutOfBoundsException("out is too small: " + out.length);
+        }
+        return containsArray(handle, values, off, len, out);
+    }
+
+    public int containsAll(long[] values, boolean[] out) {
+        return containsAll(values, 0, values.length, out);
+    }
+
+    private native int addBuffer(long handle, ByteBuffer values, int off, int len);
+
+    /**
+     * Adds len longs starting at long index off of a direct buffer in native
+     * byte order. Returns the number of values actually added.
+     */
+    public int addAll(ByteBuffer values, int off, int len) {
+        checkBuffer(values, off, len);
+        return addBuffer(handle, values, off, len);
+    }
+
+    private native int containsBuffer(long handle, ByteBuffer values, int off, int len,
+                                      ByteBuffer out);
+
+    /**
+     * Checks len longs starting at long index off of a direct buffer in native
+     * byte order. Bit i of the direct buffer out is set when value i exists
+     * (out may be null). Returns the number of values found.
+     */
+    public int containsAll(ByteBuffer values, int off, int len, ByteBuffer out) {
+        checkBuffer(values, off, len);
+        if (out != null && (!out.isDirect() || out.capacity() < (len + 7) / 8)) {
+            throw new IllegalArgumentException("out should be a direct buffer of "
+                    + (len + 7) / 8 + " bytes");
+        }
+        return containsBuffer(handle, values, off, len, out);
+    }
+
+    private static void checkRange(int length, int off, int len) {
+        if (off < 0 || len < 0 || off > length - len) {
+            throw new IndexOutOfBoundsException("off=" + off + ", len=" + len
+                    + ", length=" + length);
+        }
+    }
+
+    private static void checkBuffer(ByteBuffer values, int off, int len) {
+        if (!values.isDirect()) {
+            throw new IllegalArgumentException("values should be a direct buffer");
+        }
+        checkRange(values.capacity() / Long.BYTES, off, len);
+    }
+
     private native boolean addExclusive(long handle, long value, long other);
 
     public boolean addExclusive(long value, JniLongSet other) {
         return addExclusive(handle, value, other.handle);
     }
 
+    private native long intersectWith(long handle, long other);
+
+    /**
+     * Keeps only the values also in other, returns the number removed.
+     * Lookups reuse the hash codes stored in the nodes.
+     */
+    public long intersectWith(JniLongSet other) {
+        return intersectWith(handle, other.handle);
+    }
+
+    private native long subtract(long handle, long other);
+
+    /**
+     * Removes the values also in other, returns the number removed.
+     */
+    public long subtract(JniLongSet other) {
+        return subtract(handle, other.handle);
+    }
+
+    private native long symmetricDifference(long handle, long a, long b);
+
+    /**
+     * Adds the values in exactly one of a and b, returns the number added.
+     * When this set is a (or b) the result replaces its contents.
+     */
+    public long symmetricDifference(JniLongSet a, JniLongSet b) {
+        return symmetricDifference(handle, a.handle, b.handle);
+    }
+
+    private native long intersectionSize(long handle, long other);
+
+    public long intersectionSize(JniLongSet other) {
+        return intersectionSize(handle, other.handle);
+    }
+
+    private native long differenceSize(long handle, long other);
+
+    /**
+     * Returns the number of values in this set but not in other.
+     */
+    public long differenceSize(JniLongSet other) {
+        return differenceSize(handle, other.handle);
+    }
+
+    private native long symmetricDifferenceSize(long handle, long other);
+
+    public long symmetricDifferenceSize(JniLongSet other) {
+        return symmetricDifferenceSize(handle, other.handle);
+    }
+
     private native boolean remove(long handle, long value);
 
     public boolean remove(long value) {
@@ -49,6 +192,50 @@ public class JniLongSet extends NativeReference  implements Iterable<Long> {
         return handle != 0 ? size(handle) : 0;
     }
 
+    private native void reserve(long handle, long expectedCount);
+
+    /**
+     * Pre-sizes every partition for expectedCount values so that later adds
+     * do not pay for repeated doublings. Must not run concurrently with
+     * other modifications.
+     */
+    public void reserve(long expectedCount) {
+        reserve(handle, expectedCount);
+    }
+
+    private native long compact(long handle);
+
+    /**
+     * Shrinks partitions that became sparse after removals and returns the
+     * freed native memory in bytes. Must not run concurrently with other
+     * operations on the set.
+     */
+    public long compact() {
+        return handle != 0 ? compact(handle) : 0;
+    }
+
+    private native int memoryUsage(long handle, long[] out);
+
+    /**
+     * Returns the bytes of native memory held by the set.
+     */
+    public long memoryUsage() {
+        long[] usage = new long[MEM_FIELDS];
+        memoryUsage(handle, usage);
+        return usage[MEM_TOTAL];
+    }
+
+    /**
+     * Returns the native memory of each partition, indexed by the MEM_*
+     * fields. Memory mapped from a snapshot belongs to no partition.
+     */
+    public long[][] memoryUsageByPartition() {
+        int partitions = memoryUsage(handle, null);
+        long[] usage = new long[(partitions + 1) * MEM_FIELDS];
+        memoryUsage(handle, usage);
+        return splitMemoryUsage(usage, partitions);
+    }
+
     private native void clear(long handle);
 
     public void clear() {
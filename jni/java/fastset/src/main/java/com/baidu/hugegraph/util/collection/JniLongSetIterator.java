@@ -25,6 +25,19 @@ public class JniLongSetIterator extends NativeReference implements Iterator<Long
         }
         throw new NullPointerException();
     }
+    private native int nextBatch(long handle, long[] out);
+
+    /**
+     * Fills out with as many values as fit, returns the number of values
+     * filled (0 when the iteration is finished).
+     */
+    public int nextBatch(long[] out) {
+        if (handle != 0) {
+            return nextBatch(handle, out);
+        }
+        throw new NullPointerException();
+    }
+
     @Override
     public void close() {
         if (handle != 0) {
@@ -1,8 +1,36 @@
 package com.baidu.hugegraph.util.collection;
 
 import java.io.Closeable;
+import java.util.Arrays;
 
 public abstract class NativeReference implements Closeable {
+
+    /**
+     * Fields of the arrays returned by memoryUsageByPartition(), in bytes.
+     * DATA_CHUNKS includes FREE_LISTS and WASTED_TAIL.
+     */
+    public static final int MEM_TOTAL = 0;
+    public static final int MEM_NODE_TABLE = 1;
+    public static final int MEM_DATA_CHUNKS = 2;
+    public static final int MEM_FREE_LISTS = 3;
+    public static final int MEM_WASTED_TAIL = 4;
+    public static final int MEM_OVERHEAD = 5;
+    public static final int MEM_MAPPED = 6;
+    public static final int MEM_FIELDS = 7;
+
+    /**
+     * Splits the native layout [set fields][partition 0 fields]... into one
+     * array per partition.
+     */
+    static long[][] splitMemoryUsage(long[] usage, int partitions) {
+        long[][] result = new long[partitions][];
+        for (int i = 0; i < partitions; i++) {
+            result[i] = Arrays.copyOfRange(usage, (i + 1) * MEM_FIELDS,
+                                           (i + 2) * MEM_FIELDS);
+        }
+        return result;
+    }
+
     @Override
     @Deprecated
     protected void finalize() throws Throwable {
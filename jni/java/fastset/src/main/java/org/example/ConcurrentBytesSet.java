@@ -7,6 +7,8 @@ import com.baidu.hugegraph.util.collection.JniLongSet;
 import com.baidu.hugegraph.util.collection.JniLongSetIterator;
 import com.baidu.hugegraph.util.collection.JniSetLoader;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.Collection;
 import java.util.Iterator;
 import java.util.Set;
@@ -44,19 +46,34 @@ public class ConcurrentBytesSet implements Set<byte[]> {
         return new Iterator<byte[]>() {
 
             JniBytesSetIterator iterator = jniObj.iterator();
+            // 每次 jni 调用取一批数据（单个数据最多 32 KB）
+            ByteBuffer buffer = ByteBuffer.allocateDirect(64 * 1024)
+                                          .order(ByteOrder.nativeOrder());
+            int count = 0;
+
             @Override
             public boolean hasNext() {
-                boolean has = iterator != null && iterator.hasNext();
-                if (!has && iterator != null) {
-                    close();
+                if (count > 0) {
+                    return true;
+                }
+                if (iterator != null) {
+                    buffer.clear();
+                    count = iterator.nextBatch(buffer);
+                    if (count == 0) {
+                        iterator.close();
+                        iterator = null;
+                    }
                 }
-                return has;
+                return count > 0;
             }
 
             @Override
             public byte[] next() {
-                if (iterator != null) {
-                    return iterator.next();
+                if (hasNext()) {
+                    byte[] value = new byte[buffer.getInt()];
+                    buffer.get(value);
+                    count--;
+                    return value;
                 }
                 return null;
             }
@@ -42,19 +42,31 @@ public class ConcurrentLongSet implements Set<Long> {
         return new Iterator<Long>() {
 
             JniLongSetIterator iterator = jniObj.iterator();
+            // 每次 jni 调用取一批数据
+            long[] buffer = new long[1024];
+            int count = 0;
+            int index = 0;
+
             @Override
             public boolean hasNext() {
-                boolean has = iterator != null && iterator.hasNext();
-                if (!has && iterator != null) {
-                    iterator.close();
+                if (index < count) {
+                    return true;
+                }
+                if (iterator != null) {
+                    count = iterator.nextBatch(buffer);
+                    index = 0;
+                    if (count == 0) {
+                        iterator.close();
+                        iterator = null;
+                    }
                 }
-                return has;
+                return index < count;
             }
 
             @Override
             public Long next() {
-                if (iterator != null) {
-                    return iterator.next();
+                if (hasNext()) {
+                    return buffer[index++];
                 }
                 return null;
             }
@@ -83,21 +95,27 @@ public class ConcurrentLongSet implements Set<Long> {
 
     @Override
     public boolean containsAll(Collection<?> c) {
-        throw new RuntimeException("Method not implement.");
+        long[] values = toLongArray(c);
+        return jniObj.containsAll(values, null) == values.length;
     }
 
     @Override
     public boolean addAll(Collection<? extends Long> c) {
-        boolean change = false;
         if (c instanceof ConcurrentLongSet) {
             jniObj.addAll(((ConcurrentLongSet) c).jniObj);
             return true;
-        } else {
-            for (Long value : c) {
-                change = add(value) | change;
-            }
         }
-        return change;
+        // 一次 jni 调用加入全部数据
+        return jniObj.addAll(toLongArray(c)) > 0;
+    }
+
+    private static long[] toLongArray(Collection<?> c) {
+        long[] values = new long[c.size()];
+        int n = 0;
+        for (Object value : c) {
+            values[n++] = (Long) value;
+        }
+        return values;
     }
 
 
@@ -3,6 +3,10 @@ package org.example;
 import org.junit.Assert;
 import org.junit.Test;
 
+import com.baidu.hugegraph.util.collection.JniLongSet;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.ArrayList;
 import java.util.Iterator;
 
@@ -45,6 +49,59 @@ public class AppTest {
         Assert.assertEquals(0, set.size());
     }
 
+    @Test
+    public void testLongSetBulk() {
+        JniLongSet set = new JniLongSet(4, 0);
+        long[] values = new long[200];
+        for (int i = 0; i < values.length; i++)
+            values[i] = i % 100;
+        Assert.assertEquals(50, set.addAll(values, 0, 50));
+        Assert.assertEquals(50, set.addAll(values, 50, 150));
+        Assert.assertEquals(100, set.size());
+
+        boolean[] out = new boolean[values.length];
+        for (int i = 0; i < values.length; i++)
+            values[i] = i;
+        Assert.assertEquals(100, set.containsAll(values, out));
+        for (int i = 0; i < values.length; i++)
+            Assert.assertEquals(i < 100, out[i]);
+
+        ByteBuffer buffer = ByteBuffer.allocateDirect(values.length * Long.BYTES)
+                                      .order(ByteOrder.nativeOrder());
+        for (int i = 0; i < values.length; i++)
+            buffer.putLong(i * Long.BYTES, i + 100);
+        Assert.assertEquals(100, set.addAll(buffer, 0, values.length));
+        Assert.assertEquals(200, set.size());
+
+        ByteBuffer bitmap = ByteBuffer.allocateDirect((values.length + 7) / 8);
+        Assert.assertEquals(100, set.containsAll(buffer, 100, 100, bitmap));
+        Assert.assertEquals((byte) 0xff, bitmap.get(0));
+
+        set.close();
+    }
+
+    @Test
+    public void testMemoryUsage() {
+        JniLongSet set = new JniLongSet(3, 0);
+        long empty = set.memoryUsage();
+        for (long i = 0; i < 1000000; i++)
+            set.add(i);
+        Assert.assertTrue(set.memoryUsage() > empty);
+
+        long[][] parts = set.memoryUsageByPartition();
+        Assert.assertEquals(8, parts.length);
+        long nodes = 0;
+        for (long[] part : parts) {
+            Assert.assertEquals(JniLongSet.MEM_FIELDS, part.length);
+            Assert.assertTrue(part[JniLongSet.MEM_DATA_CHUNKS] >=
+                              part[JniLongSet.MEM_FREE_LISTS] +
+                              part[JniLongSet.MEM_WASTED_TAIL]);
+            nodes += part[JniLongSet.MEM_NODE_TABLE];
+        }
+        Assert.assertTrue(nodes > 0);
+        set.close();
+    }
+
     @Test
     public void testBytesSet() {
         ConcurrentBytesSet set = new ConcurrentBytesSet();
@@ -1,16 +1,36 @@
 
+#include <algorithm>
 #include <assert.h>
+#include <condition_variable>
 #include <cstring>
+#include <exception>
 #include <math.h>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <pthread.h>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string>
 #include <thread>
 #include <time.h>
+#include <type_traits>
 #include <unistd.h>
 #include <vector>
 
-namespace fastset {
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 //////////////////////////////////////////////////////////
 // configure:
@@ -19,27 +39,48 @@ namespace fastset {
 #define _LOG_FOR_ERROR
 
 // #define DEBUG_VERIFY_AFTER_ENLARGE
+// 扩容结束时在发布新的 mask 后等待（微秒），用于测试读线程的并发查找
+// #define DEBUG_DELAY_FINISH_ENLARGE 200
 // #define _DUMP_STAT_BEFORE_CLEAR
 
 // #define TEST_SPINLOCK
 
+// 关闭 hashCode 的 SIMD 批量比较（使用逐个比较）
+// #define DISABLE_SIMD_PROBE
+
 // end of configure
 //////////////////////////////////////////////////////////
 
 #ifdef _LOG_FOR_DEBUG
 #define LOG_DEBUG printf
 #else
-#define LOG_DEBUG(a, ...) NULL
+#define LOG_DEBUG(a, ...) ((void)0)
 #endif
 
 #ifdef _LOG_FOR_ERROR
 #define LOG_ERROR printf
 #else
-#define LOG_ERROR(a, ...) NULL
+#define LOG_ERROR(a, ...) ((void)0)
 #endif
 
 #define LOG_INFO printf
 
+#if !defined(DISABLE_SIMD_PROBE) && defined(__AVX2__)
+#include <immintrin.h>
+#define _PROBE_AVX2
+#define _PROBE_SSE2
+#elif !defined(DISABLE_SIMD_PROBE) && defined(__SSE2__)
+#include <emmintrin.h>
+#define _PROBE_SSE2
+#endif
+
+#if defined(__SSE4_2__) && (defined(__x86_64__) || defined(_M_X64))
+#include <nmmintrin.h>
+#define _HASH_CRC32C
+#endif
+
+namespace fastset {
+
 const int MAX_COUNT_PER_NODE = 4;
 const int MAX_CAPACITY_BITS = 30; // 最多允许的 1G个点
 const int DEF_CAPACITY_BITS = 12;
@@ -48,8 +89,32 @@ const int MIN_CAPACITY_BITS = 4; // 最小 16个hashNode
 const int MAX_PARTITION_BITS = 8; // 最多 256个分区
 const int DEF_PARTITION_BITS = 4;
 const int DATA_CHUNK_SIZE = (1 << 20);
+const int HUGE_PAGE_SIZE = (2 << 20); // 大页时数据块按此大小成组申请
 const float HASH_RATIO = 2.8;
 
+const uint32_t SNAPSHOT_VERSION = 2; // 2: 增加 hashId
+const int SNAPSHOT_ALIGN = 4096; // 快照中各段数据按页对齐，以便 mmap 后直接使用
+
+const int PREFETCH_WINDOW = 16; // 批量操作时，提前计算hash并预取节点的个数
+const int REHASH_STEP = 4; // 渐进扩容时，每次 add 迁移（分裂）的节点数
+const int REHASH_STRIPE = 256; // 多线程协作扩容时，每次领取的节点数
+
+const int DEF_ARENA_COUNT = 16;          // 线程安全版本中，每个分区的 arena 数
+const int ARENA_BLOCK_SIZE = (1 << 16); // arena 每次从数据块中取的大小
+const int SIZE_CLASS_COUNT = 17;        // 按 log2 索引的大小分类（小于 64 KB）
+const int EPOCH_RECLAIM_BATCH = 64; // 等待回收的内存达到此数时尝试回收
+const int COUNTER_STRIPES = 16; // 分区计数分散到的缓存行数（按线程序号）
+const int COUNTER_BATCH = 64;   // 每行累计超过此数时并入总数
+const int LOCK_SPIN_ROUNDS = 8; // 加锁失败时自旋的轮数（每轮 pause 次数翻倍）
+
+const int BLOOM_BITS_PER_KEY = 10; // Bloom filter 每项的位数（误判率约 1%）
+const int BLOOM_PROBES = 7;        // Bloom filter 每项设置的位数
+const int SPILL_CHECK_INTERVAL = 4096; // 分区每增加这么多项检查一次内存预算
+const int SPILL_MERGE_RUNS = 4; // 大小相近的 run 达到此数时，后台合并为一个
+
+const int SWISS_GROUP_SIZE = 14; // 开放寻址时每组的数据个数
+const int SWISS_MAX_LOAD = 12;   // 开放寻址时每组的平均数据个数超过此值则扩容
+
 template <class T> class CAutoLock {
   T *m_pLock;
 
@@ -61,41 +126,192 @@ public:
   ~CAutoLock() { m_pLock->unlock(); }
 };
 
+// 读写锁：查找加读锁、多个读者可以并行，修改加写锁。写者优先，避免持续的
+// 查找使扩容等写操作饥饿（只在 glibc 上设置，其他平台使用默认的策略）
+class CRWLock {
+  pthread_rwlock_t m_lock;
+
+public:
+  CRWLock() {
+#if defined(__GLIBC__)
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr,
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&m_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+#else
+    pthread_rwlock_init(&m_lock, nullptr);
+#endif
+  }
+  ~CRWLock() { pthread_rwlock_destroy(&m_lock); }
+  CRWLock(const CRWLock &) = delete;
+  CRWLock &operator=(const CRWLock &) = delete;
+
+  void lock() { pthread_rwlock_wrlock(&m_lock); }
+  void unlock() { pthread_rwlock_unlock(&m_lock); }
+  void lockShared() { pthread_rwlock_rdlock(&m_lock); }
+  void unlockShared() { pthread_rwlock_unlock(&m_lock); }
+};
+
+template <class T> class CAutoSharedLock {
+  T *m_pLock;
+
+public:
+  CAutoSharedLock(T *m) {
+    m_pLock = m;
+    m_pLock->lockShared();
+  }
+  ~CAutoSharedLock() { m_pLock->unlockShared(); }
+};
+
 class SpinnedLock {
+  // 自适应锁：先读后试（TTAS），失败时 pause 自旋并指数退避，仍未取得则
+  // futex 休眠。锁字的最高位表示有线程休眠，解锁时只在此位被设置时唤醒，
+  // 无竞争时加锁、解锁各一次原子操作
+  static const uint32_t WAITERS = 0x80000000;
+
+public:
+#ifdef _LOG_FOR_METRICS
+  // 竞争统计（只在慢路径上计数）
+  struct Stats {
+    uint64_t contended; // 首次尝试未取得的加锁次数
+    uint64_t spins;     // pause 的次数
+    uint64_t waits;     // futex 休眠的次数
+    uint64_t wakes;     // 解锁时 futex 唤醒的次数
+  };
+
+  static Stats getStats() { return stats(); }
+
+  static void resetStats() { stats() = Stats{0, 0, 0, 0}; }
+
+private:
+  static Stats &stats() {
+    static Stats s{0, 0, 0, 0};
+    return s;
+  }
+
 public:
+#endif
+
+  static inline void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause(); // 即 _mm_pause
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  // 自旋等待 *p 不再等于 v，round 为已等待的轮数（从 0 开始），
+  // 每轮 pause 的次数翻倍，超过 LOCK_SPIN_ROUNDS 轮时返回 false
+  static bool spin(const volatile uint32_t *p, uint32_t v, int &round) {
+    if (round >= LOCK_SPIN_ROUNDS) {
+      return false;
+    }
+    int n = 1 << round++;
+    for (int i = 0; i < n && *p == v; i++) {
+      pause();
+    }
+#ifdef _LOG_FOR_METRICS
+    __sync_fetch_and_add(&stats().spins, n);
+#endif
+    return true;
+  }
+
   static void doLock(volatile uint32_t *p, const char *msg) {
 #if defined(TEST_SPINLOCK)
-    uint32_t tid = pthread_self();
+    uint32_t tid = ((uint32_t)pthread_self() & ~WAITERS) | 1;
 #else
     uint32_t tid = 1;
 #endif
-    int n = 0;
-    while (__sync_lock_test_and_set(p, tid) != 0) {
+    if (!__sync_bool_compare_and_swap(p, 0, tid)) {
 #ifdef TEST_SPINLOCK
-      if (n == 0) {
-        LOG_INFO("%u wait for lock (%s). lockobj: %p owner: %u\n", tid, msg, p,
-                 *p);
-      }
+      LOG_INFO("%u wait for lock (%s). lockobj: %p owner: %u\n", tid, msg, p,
+               *p);
 #endif
-      if ((++n & 0x1ff) == 0) { // every 1024
-        usleep(10);             // sleep 10 us
-        // if (n > 1000000) {
-        //   LOG_ERROR("doLock(%s) may be deadlock(%p) ???", msg, p);
-        // }
-      }
+      lockSlow(p, 0, tid);
     }
 #ifdef TEST_SPINLOCK
     LOG_INFO("%u locked (%s). lockobj: %p owner: %u\n", tid, msg, p, *p);
 #endif
   }
 
+  // 带版本号的锁（seqlock）：*p 的最低位为 0 时未加锁，加锁、解锁时各加一，
+  // 不加锁的读者据此判断读取期间是否有写入（见 HashNodeBase）
+  static void doSeqLock(volatile uint32_t *p) {
+    uint32_t v = *p;
+    if ((v & 1) == 0 && __sync_bool_compare_and_swap(p, v, v + 1)) {
+      return;
+    }
+    lockSlow(p, 1, 1);
+  }
+
+  static void doSeqUnlock(volatile uint32_t *p) {
+    // 版本号加一（溢出时不进入最高位），同时清除休眠标志
+    uint32_t v;
+    do {
+      v = *p;
+    } while (!__sync_bool_compare_and_swap(p, v, (v + 1) & ~WAITERS));
+    if (v & WAITERS) {
+      wake(p);
+    }
+  }
+
   static void doUnlock(volatile uint32_t *p, const char *msg) {
 #if defined(TEST_SPINLOCK)
-    uint32_t tid = pthread_self();
+    uint32_t tid = ((uint32_t)pthread_self() & ~WAITERS) | 1;
     LOG_INFO("%u unlock (%s). lockobj: %p owner: %u,  %s\n", tid, msg, p, *p,
-             tid == *p ? "ok" : "ERROR");
+             tid == (*p & ~WAITERS) ? "ok" : "ERROR");
+#endif
+    if (__sync_fetch_and_and(p, 0) & WAITERS) {
+      wake(p);
+    }
+  }
+
+private:
+  // 加锁的慢路径。lockBit 非 0 时为 seqlock：(*p & lockBit) == 0 为未加锁，
+  // 加锁时加一；否则 *p == 0 为未加锁，加锁时置为 value
+  static void lockSlow(volatile uint32_t *p, uint32_t lockBit, uint32_t value) {
+#ifdef _LOG_FOR_METRICS
+    __sync_fetch_and_add(&stats().contended, 1);
+#endif
+    int round = 0;
+    for (;;) {
+      uint32_t v = *p;
+      bool locked = lockBit != 0 ? (v & lockBit) != 0 : v != 0;
+      if (!locked) {
+        // 休眠过的线程取得锁时保留休眠标志：可能还有其他线程在休眠
+        uint32_t flag = round >= LOCK_SPIN_ROUNDS ? WAITERS : 0;
+        uint32_t next = lockBit != 0 ? v + 1 : value;
+        if (__sync_bool_compare_and_swap(p, v, next | flag)) {
+          return;
+        }
+      } else if (!spin(p, v, round)) {
+        // 设置休眠标志后休眠，解锁时清除标志并唤醒一个线程
+        if ((v & WAITERS) == 0 &&
+            !__sync_bool_compare_and_swap(p, v, v | WAITERS)) {
+          continue;
+        }
+#ifdef _LOG_FOR_METRICS
+        __sync_fetch_and_add(&stats().waits, 1);
+#endif
+#ifdef __linux__
+        syscall(SYS_futex, p, FUTEX_WAIT_PRIVATE, v | WAITERS, nullptr, nullptr,
+                0);
+#else
+        usleep(10);
+#endif
+      }
+    }
+  }
+
+  static void wake(volatile uint32_t *p) {
+#ifdef _LOG_FOR_METRICS
+    __sync_fetch_and_add(&stats().wakes, 1);
+#endif
+#ifdef __linux__
+    syscall(SYS_futex, p, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
 #endif
-    __sync_lock_release(p);
   }
 
 private:
@@ -123,6 +339,23 @@ public:
     __sync_fetch_and_add(p, v);
   }
 
+  template <class T> static inline bool CAS(volatile T *p, T oldv, T newv) {
+    return __sync_bool_compare_and_swap(p, oldv, newv);
+  }
+
+  // 之前的读不会被重排到之后的读之后（x86 上只限制编译器）
+  static inline void LoadBarrier() { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+
+  static int ThreadSlot() {
+    // 线程序号，首次调用时按顺序分配
+    static volatile int s_nextSlot = 0;
+    static thread_local int slot = -1;
+    if (slot < 0) {
+      slot = __sync_fetch_and_add(&s_nextSlot, 1) & 0x7fffffff;
+    }
+    return slot;
+  }
+
   // template <class T> static void SetMax(T *p, int value) {
   //   T old = *p;
   //   while (!__sync_bool_compare_and_swap(p, old, std::max(old, value))) {
@@ -141,8 +374,13 @@ struct Slice {
   }
 };
 
+// hash 策略：提供各种类型数据的 get()，返回的 hashCode 最高位一定为 0（31 位），
+// 分区号由 CalcHash::getShort(hashCode) 计算，与策略无关。ID 保存在快照中，
+// 加载时校验。FastHashSetImpl 的 Hasher 模板参数默认为 CalcHash
 class CalcHash {
 public:
+  static const uint32_t ID = 1;
+
   static uint32_t get_(unsigned char *data, int len) {
     // 一亿次：1200ms (1456-258)
     uint32_t p = 16777619;
@@ -156,14 +394,16 @@ public:
   static uint32_t get(unsigned char *data, int len) {
     // 一亿次：700ms (933-228)
     uint32_t h = len;
-    uint32_t *src = (uint32_t *)data;
-    for (int i = 0; i < len / sizeof(uint32_t); i++) {
-      h ^= src[i];
+    int tail = len & ~3;
+    for (int i = 0; i < tail; i += sizeof(uint32_t)) {
+      uint32_t w;
+      memcpy(&w, data + i, sizeof(w)); // 不要求 4 字节对齐
+      h ^= w;
       h += h << 5;
     }
     // 最后几个字节
     uint32_t t = 0;
-    for (int i = (len & 0x7ffffff8); i < len; i++) {
+    for (int i = tail; i < len; i++) {
       t = (t << 8) | data[i];
     }
     return get(h ^ t);
@@ -201,930 +441,3848 @@ public:
   }
 };
 
-class CBufferManager {
-
-  using AutoLock = CAutoLock<std::mutex>;
+class MixHash {
+  // xxh3/wyhash 风格的 64 位混合：整个 64 位参与乘法，高低位的结构性规律
+  // （如 id 高位为类型、低位为序号）不会因异或折叠而相互抵消
+public:
+  static const uint32_t ID = 2;
+
+  static uint64_t mix(uint64_t v) {
+    // xxh3 的 rrmxmx 收尾
+    v ^= rotl(v, 49) ^ rotl(v, 24);
+    v *= 0x9fb21c651e98df25ULL;
+    v ^= (v >> 35) + 8;
+    v *= 0x9fb21c651e98df25ULL;
+    v ^= v >> 28;
+    return v;
+  }
 
-  struct SizeItem {
-    int size;
-    std::mutex mutex;
-    std::vector<unsigned char *> hot; // 刚用完的内存
-    std::vector<unsigned char *> cool;
-  };
-  std::vector<SizeItem *> m_recyclers;
-  std::vector<unsigned char *> m_chunks;
-  int m_usedPos{0};
-  bool m_cocurrent;
+  static uint32_t get(uint64_t v) { return fold(mix(v)); }
 
-#ifdef _LOG_FOR_METRICS
-  struct {
-    int alloc_count;
-    int max_alloc_size;
-  } m_matrics{0, 0};
-#endif
+  static uint32_t get(int64_t v) { return get((uint64_t)v); }
 
-  std::mutex m_mutex;
+  static uint32_t get(uint32_t v) { return get((uint64_t)v); }
 
-public:
-  CBufferManager(bool cocurrent) : m_cocurrent(cocurrent) {}
+  static uint32_t get(int32_t v) { return get((uint64_t)(uint32_t)v); }
 
-  ~CBufferManager() { clear(); }
+  static uint32_t get(unsigned char *data, int len) {
+    uint64_t h = (uint64_t)len * 0x9e3779b97f4a7c15ULL;
+    int tail = len & ~7;
+    for (int i = 0; i < tail; i += sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, data + i, sizeof(w));
+      h = (h ^ mix(w)) * 0xbf58476d1ce4e5b9ULL;
+    }
+    uint64_t t = 0;
+    for (int i = tail; i < len; i++) {
+      t = (t << 8) | data[i];
+    }
+    return fold(mix(h ^ t));
+  }
 
-  unsigned char *alloc(int size) {
-    assert(size < (1 << 16));
+  static uint32_t get(const Slice &slice) { return get(slice.buf, slice.len); }
 
-    return _alloc(size);
+private:
+  static inline uint64_t rotl(uint64_t v, int n) {
+    return (v << n) | (v >> (64 - n));
   }
 
-  void dealloc(unsigned char *buf, int size) { return _dealloc(buf, size); }
-
-  void clear() {
-    if (m_cocurrent) {
-      AutoLock lock(&m_mutex);
-      return _clear();
-    } else {
-      return _clear();
-    }
+  static inline uint32_t fold(uint64_t h) {
+    return (uint32_t)(h >> 32) & 0x7fffffff; // 高位混合最充分
   }
+};
 
-  void dump_stat(const char *msg) {
-#ifdef _LOG_FOR_METRICS
-    LOG_INFO(
-        "%s mem: chunks=%ld, alloc_count=%d, max_size=%d, diff_size=%ld: [",
-        msg, m_chunks.size(), m_matrics.alloc_count, m_matrics.max_alloc_size,
-        m_recyclers.size());
+class Crc32cHash {
+  // 使用 SSE4.2 的 crc32 指令，每个 64 位数只需一条指令（约 3 个周期）。
+  // crc 是线性的，高低位规律仍会部分保留，因此再做一次乘法混合。
+  // 没有 SSE4.2 时使用逐位计算的软件实现（很慢，仅用于保证结果一致）
+public:
+  static const uint32_t ID = 3;
+
+  static uint32_t crc(uint32_t c, uint64_t v) {
+#ifdef _HASH_CRC32C
+    return (uint32_t)_mm_crc32_u64(c, v);
 #else
-    LOG_INFO("%s mem: chunks=%ld, diff_size=%ld: [", msg, m_chunks.size(),
-             m_recyclers.size());
-#endif
-    for (int i = 0; i < m_recyclers.size(); i++) {
-      if (i == 0) {
-        LOG_INFO("%d", m_recyclers[i]->size);
-      } else {
-        LOG_INFO(",%d", m_recyclers[i]->size);
+    for (int i = 0; i < 8; i++) {
+      c ^= (uint8_t)(v >> (i * 8));
+      for (int k = 0; k < 8; k++) {
+        c = (c >> 1) ^ (0x82f63b78 & (0 - (c & 1)));
       }
     }
-    LOG_INFO("]\n");
+    return c;
+#endif
   }
 
-private:
-  unsigned char *_alloc(int size) {
-#ifdef _LOG_FOR_METRICS
-    if (m_cocurrent)
-      m_mutex.lock();
-    m_matrics.alloc_count++;
-    if (m_matrics.max_alloc_size < size)
-      m_matrics.max_alloc_size = size;
-    if (m_cocurrent)
-      m_mutex.unlock();
-#endif
-    SizeItem *item = getRecycler(size);
-    if (item->cool.size() > 0) {
-      unsigned char *buf = item->cool.back();
-      item->cool.pop_back();
-      unlockItem(item);
-      return buf;
-    } else {
-      unlockItem(item);
-    }
+  static uint32_t get(uint64_t v) { return fold(crc(0xffffffff, v)); }
 
-    // alloc from m_chunks
-    if (m_cocurrent)
-      m_mutex.lock();
-    if (m_chunks.size() == 0 || m_usedPos + size >= DATA_CHUNK_SIZE) {
-      allocChunk();
-    }
-    unsigned char *buf = m_chunks.back() + m_usedPos;
-    m_usedPos += size;
-    if (m_cocurrent)
-      m_mutex.unlock();
-    return buf;
-  }
+  static uint32_t get(int64_t v) { return get((uint64_t)v); }
 
-  void _dealloc(unsigned char *buf, int count) {
-    SizeItem *item = getRecycler(count);
-    item->hot.push_back(buf);
+  static uint32_t get(uint32_t v) { return get((uint64_t)v); }
 
-    if (item->hot.size() > 1024) {
-      int count = item->hot.size() / 2;
-      for (int i = 0; i < count; i++) {
-        item->cool.push_back(item->hot[i]);
-      }
-      item->hot.erase(item->hot.begin(), item->hot.begin() + count);
-    }
-    unlockItem(item);
-  }
+  static uint32_t get(int32_t v) { return get((uint64_t)(uint32_t)v); }
 
-  void _clear() {
-    for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it) {
-      delete[] * it;
+  static uint32_t get(unsigned char *data, int len) {
+    uint32_t c = 0xffffffff ^ (uint32_t)len;
+    int tail = len & ~7;
+    for (int i = 0; i < tail; i += sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, data + i, sizeof(w));
+      c = crc(c, w);
     }
-    m_chunks.clear();
-
-    for (auto it = m_recyclers.begin(); it != m_recyclers.end(); ++it) {
-      delete *it;
+    uint64_t t = 0;
+    for (int i = tail; i < len; i++) {
+      t = (t << 8) | data[i];
     }
-    m_recyclers.clear();
-    m_usedPos = 0;
-
-#ifdef _LOG_FOR_METRICS
-    memset(&m_matrics, 0, sizeof(m_matrics));
-#endif
+    return fold(crc(c, t));
   }
 
-  void allocChunk() {
-    m_chunks.push_back(new unsigned char[DATA_CHUNK_SIZE]);
-    m_usedPos = 0;
+  static uint32_t get(const Slice &slice) { return get(slice.buf, slice.len); }
+
+private:
+  static inline uint32_t fold(uint32_t c) {
+    return (uint32_t)(((uint64_t)c * 0x9e3779b97f4a7c15ULL) >> 33);
   }
+};
 
-  // count is power of 2
-  SizeItem *getRecycler(int size) {
-    AutoLock lock(&m_mutex);
-    SizeItem *item = nullptr;
-    for (int i = 0; i < m_recyclers.size(); i++) {
-      item = m_recyclers[i];
-      if (item->size == size) {
-        lockItem(item);
-        return item;
+class CodeProbe {
+public:
+  // 在 codes[0, count) 中查找与 hashCode 相同的项，只有 hashCode 相同时才比较
+  // values。readable 为 codes 可安全读取的长度（4 的倍数，且不小于 count）
+  template <class T>
+  static int32_t find(const uint32_t *codes, const T *values, int count,
+                      int readable, const T &v, uint32_t hashCode) {
+    int i = 0;
+#ifdef _PROBE_AVX2
+    for (; i < count && i + 8 <= readable; i += 8) {
+      uint32_t m = match8(codes + i, hashCode) & tailMask(count - i);
+      for (; m != 0; m &= m - 1) {
+        int k = i + __builtin_ctz(m);
+        if (values[k] == v) {
+          return k;
+        }
       }
     }
-    item = new SizeItem;
-    item->size = size;
-    lockItem(item);
-    m_recyclers.push_back(item);
-    return item;
+#endif
+    for (; i < count; i += 4) {
+      uint32_t m = match4(codes + i, hashCode) & tailMask(count - i);
+      for (; m != 0; m &= m - 1) {
+        int k = i + __builtin_ctz(m);
+        if (values[k] == v) {
+          return k;
+        }
+      }
+    }
+    return -1;
   }
 
-  void lockItem(SizeItem *item) {
-    if (m_cocurrent) {
-      item->mutex.lock();
-    }
+  // 返回 codes[0, 4) 中等于 hashCode 的位图
+  static inline uint32_t match4(const uint32_t *codes, uint32_t hashCode) {
+#ifdef _PROBE_SSE2
+    __m128i key = _mm_set1_epi32(hashCode);
+    __m128i src = _mm_loadu_si128((const __m128i *)codes);
+    return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(src, key)));
+#else
+    return (uint32_t)(codes[0] == hashCode) |
+           (uint32_t)(codes[1] == hashCode) << 1 |
+           (uint32_t)(codes[2] == hashCode) << 2 |
+           (uint32_t)(codes[3] == hashCode) << 3;
+#endif
   }
 
-  void unlockItem(SizeItem *item) {
-    if (m_cocurrent) {
-      item->mutex.unlock();
+  // 返回 tags[0, 16) 中等于 tag 的位图
+  static inline uint32_t match16(const uint8_t *tags, uint8_t tag) {
+#ifdef _PROBE_SSE2
+    __m128i key = _mm_set1_epi8((char)tag);
+    __m128i src = _mm_loadu_si128((const __m128i *)tags);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(src, key));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < 16; i++) {
+      m |= (uint32_t)(tags[i] == tag) << i;
     }
+    return m;
+#endif
   }
-};
 
-class HashNodeBase {
-protected:
-  volatile uint32_t m_lock;
-  uint16_t m_count;
-  uint16_t m_capacity;
+#ifdef _PROBE_AVX2
+  // 返回 codes[0, 8) 中等于 hashCode 的位图
+  static inline uint32_t match8(const uint32_t *codes, uint32_t hashCode) {
+    __m256i key = _mm256_set1_epi32(hashCode);
+    __m256i src = _mm256_loadu_si256((const __m256i *)codes);
+    __m256i eq = _mm256_cmpeq_epi32(src, key);
+    return _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+  }
+#endif
 
-public:
-  uint16_t getCount() const { return m_count; }
+private:
+  static inline uint32_t tailMask(int n) {
+    return n >= 32 ? 0xffffffff : (1u << n) - 1;
+  }
+};
 
-  void lock() { SpinnedLock::doLock(&m_lock, "node"); }
+// 快照文件格式：SnapshotHeader，SnapshotPartition * 分区数，之后为各分区的
+// 节点表及数据块（均按 SNAPSHOT_ALIGN 对齐）。节点中的数据块指针保存为
+// (数据块序号 * DATA_CHUNK_SIZE + 块内偏移 + 1)，0 表示无数据块
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t valueSize;
+  int32_t partitionBits;
+  int32_t initCapacityBits;
+  uint32_t hashId; // Hasher::ID，hash 策略不同时 hashCode 及数据分布都不同
+};
 
-  void unlock() { SpinnedLock::doUnlock(&m_lock, "node"); }
+struct SnapshotPartition {
+  int32_t hashMask;
+  int32_t count;
+  int64_t nodeOffset;
+  int64_t nodeCount;
+  int64_t chunkOffset;
+  int64_t chunkCount;
 };
 
-template <class T> class FixedSizeHashNode : public HashNodeBase {
-  const static int DATA_ITEM_SIZE = (sizeof(uint32_t) + sizeof(T));
+class CSnapshotFile {
+  // 快照文件的读写。读取时可以 mmap 整个文件（MAP_PRIVATE，修改不会写回），
+  // 或者按段读取到调用者提供的内存中
+  FILE *m_pFile{nullptr};
+  unsigned char *m_pMapped{nullptr};
+  int64_t m_size{0};
 
-  using HashNode = FixedSizeHashNode<T>;
+public:
+  ~CSnapshotFile() { close(); }
 
-private:
-  T *m_pValues;
-  struct {
-    T m_values[MAX_COUNT_PER_NODE];
-    uint32_t m_codes[MAX_COUNT_PER_NODE];
-  };
+  bool create(const char *path) {
+    m_pFile = fopen(path, "wb");
+    return m_pFile != nullptr;
+  }
 
-public:
-  T getValue(int index) const {
-    if (index < MAX_COUNT_PER_NODE) {
-      return m_values[index];
-    } else {
-      return m_pValues[index - MAX_COUNT_PER_NODE];
+  bool open(const char *path, bool useMmap) {
+    m_pFile = fopen(path, "rb");
+    if (m_pFile == nullptr || !seek(0, SEEK_END)) {
+      return false;
+    }
+    m_size = tell();
+    if (!useMmap) {
+      return true;
     }
+#ifndef _WIN32
+    void *p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                   fileno(m_pFile), 0);
+    if (p == MAP_FAILED) {
+      LOG_ERROR("mmap snapshot failed: %s\n", path);
+      return false;
+    }
+    m_pMapped = (unsigned char *)p;
+    return true;
+#else
+    LOG_ERROR("mmap snapshot is not supported\n");
+    return false;
+#endif
   }
 
-  uint32_t getCode(int index) const {
-    if (index < MAX_COUNT_PER_NODE) {
-      return m_codes[index];
-    } else {
-      return ((uint32_t *)(m_pValues + m_capacity))[index - MAX_COUNT_PER_NODE];
+  void close() {
+    if (m_pFile != nullptr) {
+      fclose(m_pFile);
+      m_pFile = nullptr;
     }
   }
 
-  int32_t find(const T &v) const {
-    // lockup local-item
-    int count = m_count < MAX_COUNT_PER_NODE ? m_count : MAX_COUNT_PER_NODE;
-    for (int i = 0; i < count; i++) {
-      if (m_values[i] == v) {
-        return i;
-      }
-    }
-    count = m_count - MAX_COUNT_PER_NODE;
-    for (int i = 0; i < count; i++) {
-      if (m_pValues[i] == v) {
-        return i + MAX_COUNT_PER_NODE;
-      }
+  // 取得映射的内存（由调用者负责 unmap），之后不再持有
+  unsigned char *detachMapping(int64_t &size) {
+    unsigned char *p = m_pMapped;
+    size = m_size;
+    m_pMapped = nullptr;
+    return p;
+  }
+
+  static void unmap(unsigned char *p, int64_t size) {
+#ifndef _WIN32
+    if (p != nullptr) {
+      munmap(p, size);
     }
-    return -1;
+#endif
   }
 
-  bool remove(const T &v, uint32_t hashCode) {
-    int index = find(v);
-    if (index < 0) {
+  bool isMapped() const { return m_pMapped != nullptr; }
+
+  int64_t size() const { return m_size; }
+
+  // 映射模式下，返回文件中 [offset, offset + len) 的内存
+  unsigned char *at(int64_t offset, int64_t len) const {
+    if (offset < 0 || len < 0 || offset + len > m_size) {
+      return nullptr;
+    }
+    return m_pMapped + offset;
+  }
+
+  bool read(int64_t offset, void *buf, int64_t len) {
+    if (offset < 0 || len < 0 || offset + len > m_size) {
       return false;
     }
-    if (index < m_count - 1) {
-      // 删除中间的，则需要把原先的最后一个，代替到当前位置
-      put(index, getValue(m_count - 1), getCode(m_count - 1));
+    if (m_pMapped != nullptr) {
+      memcpy(buf, m_pMapped + offset, len);
+      return true;
     }
+    return seek(offset, SEEK_SET) &&
+           fread(buf, 1, len, m_pFile) == (size_t)len;
+  }
 
-    m_count--;
-    return true;
+  bool write(const void *buf, int64_t len) {
+    return len >= 0 && fwrite(buf, 1, len, m_pFile) == (size_t)len;
   }
 
-  bool safeAdd(CBufferManager *pBufMgr, const T &v, uint32_t hashCode) {
-    if (this->find(v) >= 0) {
-      return false;
+  // 写入位置对齐到 SNAPSHOT_ALIGN，返回对齐后的位置（失败返回 -1）
+  int64_t align() {
+    static const char zeros[SNAPSHOT_ALIGN] = {0};
+    int64_t pos = tell();
+    int pad = (SNAPSHOT_ALIGN - pos % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+    if (pad > 0 && !write(zeros, pad)) {
+      return -1;
     }
-    int capacity = 0;
-    if (m_capacity == 0 && m_count == MAX_COUNT_PER_NODE) {
-      // 首次扩容
-      capacity = MAX_COUNT_PER_NODE;
-      m_pValues = (T *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
-      m_capacity = capacity;
-    } else if (m_count == MAX_COUNT_PER_NODE + m_capacity) {
-      // 已有扩展内存块，扩容
-      capacity = m_capacity * 2;
-      T *pValues = (T *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
-      memcpy(pValues, m_pValues, sizeof(T) * (m_capacity));
-      memcpy(pValues + capacity, m_pValues + m_capacity,
-             sizeof(uint32_t) * m_capacity);
+    return pos + pad;
+  }
 
-      unsigned char *pOldBuf = (unsigned char *)m_pValues;
-      int bufLen = m_capacity * DATA_ITEM_SIZE;
+  bool seek(int64_t offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(m_pFile, offset, whence) == 0;
+#else
+    return fseeko(m_pFile, offset, whence) == 0;
+#endif
+  }
 
-      m_pValues = pValues;
-      m_capacity = capacity;
+  int64_t tell() {
+#ifdef _WIN32
+    return _ftelli64(m_pFile);
+#else
+    return ftello(m_pFile);
+#endif
+  }
+};
 
-      // delay dealloc here, when node is ready (for thread-safe)
-      pBufMgr->dealloc(pOldBuf, bufLen);
+// 节点表及数据块的内存申请策略（构造函数参数）
+enum HugePageMode {
+  HUGE_PAGE_NONE,
+  HUGE_PAGE_THP,     // 透明大页：mmap + MADV_HUGEPAGE
+  HUGE_PAGE_HUGETLB, // 预留的大页：MAP_HUGETLB，失败时改用透明大页
+};
+
+enum NumaMode {
+  NUMA_NONE,
+  NUMA_INTERLEAVE, // 所有内存在各 NUMA 节点间交错分布
+  NUMA_BIND,       // 分区 i 的内存绑定到第 (i % NUMA 节点数) 个在线节点
+};
+
+struct AllocPolicy {
+  int hugePage;
+  int numa;
+  int numaNodes; // NUMA 节点数（使用节点 0 ~ numaNodes-1），0 表示自动检测
+
+  AllocPolicy(int hugePage = HUGE_PAGE_NONE, int numa = NUMA_NONE,
+              int numaNodes = 0)
+      : hugePage(hugePage), numa(numa), numaNodes(numaNodes) {}
+
+  bool isDefault() const {
+    return hugePage == HUGE_PAGE_NONE && numa == NUMA_NONE;
+  }
+};
+
+// 构造时预期的数据个数，构造后按此预先扩容（见 FastHashSetImpl::reserve）
+struct ExpectedSize {
+  int64_t count;
+
+  explicit ExpectedSize(int64_t count) : count(count) {}
+};
+
+class CPageAllocator {
+  // 按 AllocPolicy 申请大块内存。默认策略使用 calloc/malloc，其他策略使用
+  // mmap（按页延迟清零）：不小于 HUGE_PAGE_SIZE 的内存按大页对齐，再按分区
+  // 设置 NUMA 策略。非 linux 下忽略策略
+public:
+  static void *alloc(size_t size, const AllocPolicy &policy, int partIndex,
+                     bool zero = true) {
+    if (policy.isDefault()) {
+      return zero ? calloc(1, size) : malloc(size);
     }
-    put(m_count, v, hashCode);
-    m_count++;
-    return true;
+#ifdef __linux__
+    bool huge = isHuge(size, policy);
+    size_t bytes = getMappedSize(size, policy);
+    void *p = MAP_FAILED;
+    if (huge && policy.hugePage == HUGE_PAGE_HUGETLB) {
+      p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+      p = mapAligned(bytes, huge ? HUGE_PAGE_SIZE : 0);
+      if (p == MAP_FAILED) {
+        LOG_ERROR("mmap %ld bytes failed\n", (long)bytes);
+        return nullptr;
+      }
+      if (huge) {
+        madvise(p, bytes, MADV_HUGEPAGE);
+      }
+    }
+    bindNuma(p, bytes, policy, partIndex);
+    return p;
+#else
+    return zero ? calloc(1, size) : malloc(size);
+#endif
   }
 
-  int split(CBufferManager *pBufMgr, HashNode *other, int capacity) {
-    // 在rehash时，运行并行加入的同样数据，加入到新节点或老节点，因此这里返回
-    // 迁移节点时的重复个数
-    int newCount = 0;
-    int dupCount = 0;
-    for (int index = 0; index < m_count; index++) {
-      uint32_t hashCode = getCode(index);
-      T v = getValue(index);
-      if (hashCode & capacity) {
-        if (!other->safeAdd(pBufMgr, v, hashCode)) {
-          dupCount++;
-        }
-      } else {
-        if (index != newCount) {
-          // move forward
-          put(newCount, v, hashCode);
+  static void release(void *p, size_t size, const AllocPolicy &policy) {
+    if (p == nullptr) {
+      return;
+    }
+#ifdef __linux__
+    if (!policy.isDefault()) {
+      munmap(p, getMappedSize(size, policy));
+      return;
+    }
+#endif
+    free(p);
+  }
+
+  // 申请 size 字节时实际占用的内存（按页或大页取整）
+  static size_t getAllocSize(size_t size, const AllocPolicy &policy) {
+#ifdef __linux__
+    if (!policy.isDefault()) {
+      return getMappedSize(size, policy);
+    }
+#endif
+    return size;
+  }
+
+  // 解析节点列表（/sys/devices/system/node/online 的格式，如 "0-1,3"），
+  // 返回节点号小于 64 的节点的位图
+  static uint64_t parseNodeList(const char *s) {
+    uint64_t mask = 0;
+    while (*s != 0) {
+      char *end;
+      long first = strtol(s, &end, 10);
+      if (end == s || first < 0) {
+        break;
+      }
+      long last = first;
+      s = end;
+      if (*s == '-') {
+        last = strtol(s + 1, &end, 10);
+        if (end == s + 1) {
+          break;
         }
-        newCount++;
+        s = end;
+      }
+      for (long i = first; i <= last && i < 64; i++) {
+        mask |= 1ULL << i;
+      }
+      if (*s != ',') {
+        break;
       }
+      s++;
     }
-    m_count = newCount;
-    return dupCount;
+    return mask;
   }
 
-  void dump(const char *msg) const {
-    LOG_INFO("%s: Node_%p:(lock=%u,cap=%d,cnt=%d):", msg, this, m_lock,
-             m_capacity, m_count);
-    for (int i = 0; i < m_count; i++) {
-      LOG_INFO(" %x", getCode(i));
+private:
+#ifdef __linux__
+  static bool isHuge(size_t size, const AllocPolicy &policy) {
+    return policy.hugePage != HUGE_PAGE_NONE && size >= HUGE_PAGE_SIZE;
+  }
+
+  static size_t getMappedSize(size_t size, const AllocPolicy &policy) {
+    size_t align =
+        isHuge(size, policy) ? HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+    return (size + align - 1) / align * align;
+  }
+
+  static void *mapAligned(size_t bytes, size_t align) {
+    // 多映射 align 字节，再释放首尾多余的部分
+    size_t total = bytes + align;
+    void *p = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED || align == 0) {
+      return p;
     }
-    LOG_INFO("\n");
+    uintptr_t start = ((uintptr_t)p + align - 1) / align * align;
+    size_t head = start - (uintptr_t)p;
+    if (head > 0) {
+      munmap(p, head);
+    }
+    if (total - head > bytes) {
+      munmap((char *)start + bytes, total - head - bytes);
+    }
+    return (void *)start;
   }
 
-  bool debug_verify(int hashIndex, int hashMask) const {
-    for (int i = 0; i < m_count; i++) {
-      if (!debug_verify(hashIndex, hashMask, i)) {
-        return false;
+  static void bindNuma(void *p, size_t bytes, const AllocPolicy &policy,
+                       int partIndex) {
+    const int MPOL_BIND_ = 2;
+    const int MPOL_INTERLEAVE_ = 3;
+    if (policy.numa == NUMA_NONE) {
+      return;
+    }
+    uint64_t nodes;
+    if (policy.numaNodes > 0) {
+      nodes = policy.numaNodes >= 64 ? ~0ULL : (1ULL << policy.numaNodes) - 1;
+    } else {
+      nodes = getNumaNodes();
+    }
+    int count = __builtin_popcountll(nodes);
+    if (count <= 1) {
+      return;
+    }
+    unsigned long mask;
+    int mode;
+    if (policy.numa == NUMA_INTERLEAVE) {
+      mask = nodes;
+      mode = MPOL_INTERLEAVE_;
+    } else {
+      // 节点号可能不连续，取第 (partIndex % count) 个在线节点
+      for (int i = partIndex % count; i > 0; i--) {
+        nodes &= nodes - 1;
       }
+      mask = 1UL << __builtin_ctzll(nodes);
+      mode = MPOL_BIND_;
+    }
+    if (syscall(SYS_mbind, p, bytes, mode, &mask, sizeof(mask) * 8, 0) != 0) {
+      LOG_ERROR("mbind failed: %d, nodes: %lx\n", errno, mask);
     }
-    return true;
   }
 
-  bool debug_verify(int hashIndex, int hashMask, int item) const {
-    uint32_t hashCode = getCode(item);
-    int expectedIndex = hashCode & hashMask;
-    if (expectedIndex != hashIndex) {
-      char buf[256] = {0};
-      sprintf(buf, "inconsist hash value: %x: (%x & %x) != %x, diff=%x",
-              expectedIndex, hashCode, hashMask, hashIndex,
-              expectedIndex ^ hashIndex);
-      dump(buf);
-      return false;
+  static uint64_t getNumaNodes() {
+    // 在线节点的位图，读取失败时只有节点 0
+    static uint64_t s_nodes = 0;
+    if (s_nodes == 0) {
+      uint64_t nodes = 0;
+      FILE *pFile = fopen("/sys/devices/system/node/online", "rt");
+      if (pFile != nullptr) {
+        char buf[256]{0};
+        if (fgets(buf, sizeof(buf), pFile)) {
+          nodes = parseNodeList(buf);
+        }
+        fclose(pFile);
+      }
+      s_nodes = nodes != 0 ? nodes : 1;
     }
-    return true;
+    return s_nodes;
+  }
+#endif
+};
+
+// 内存占用（字节），见 memoryUsage()
+struct MemoryUsage {
+  size_t nodeTable{0};  // 节点表
+  size_t dataChunks{0}; // 数据块（节点的扩展内存），包含以下两项
+  size_t freeLists{0};  // 数据块中已释放、在回收列表中等待重用的部分
+  size_t wastedTail{0}; // 数据块中未分配的部分（丢弃的段尾及尚未使用的）
+  size_t overhead{0};   // m_table、回收列表等管理结构
+  size_t mapped{0};     // 快照映射的内存，不属于以上各项
+
+  size_t total() const { return nodeTable + dataChunks + overhead + mapped; }
+
+  MemoryUsage &operator+=(const MemoryUsage &other) {
+    nodeTable += other.nodeTable;
+    dataChunks += other.dataChunks;
+    freeLists += other.freeLists;
+    wastedTail += other.wastedTail;
+    overhead += other.overhead;
+    mapped += other.mapped;
+    return *this;
+  }
+};
+
+class CEpoch {
+  // 基于 epoch 的内存回收（EBR）：不加锁读取节点的线程在 Guard 的作用域内
+  // 读取；线程安全版本中，节点扩展内存释放时记录当时的全局 epoch，全局 epoch
+  // 前进两次之后（之前进入的读者均已离开）才重新使用。
+  // 每个线程有自己的槽位（首次进入时取得，线程退出时归还以便重用），进入时
+  // 把全局 epoch 写到槽位（带完整的内存屏障），离开时清零。读者之间不共享
+  // 缓存行，也没有对共享计数的原子读改写。
+  // 全局 epoch 只在所有读取中的线程都已看到当前 epoch 时前进，所有集合共用
+  struct Slot {
+    volatile uint64_t epoch; // 进入时的全局 epoch，0 表示不在读取中
+    int depth;               // Guard 的嵌套层数，只由所属线程访问
+    volatile int used;       // 是否已被某个线程取得
+    Slot *next;
+    char padding[64 - 2 * sizeof(uint64_t) - 2 * sizeof(int)];
+  };
+
+  struct State {
+    volatile uint64_t epoch{2};
+    Slot *volatile head{nullptr}; // 槽位只增加、不释放
+  };
+
+  static State &state() {
+    static State s;
+    return s;
+  }
+
+  // 线程退出时归还槽位
+  struct SlotOwner {
+    Slot *slot;
+    SlotOwner(Slot *p) : slot(p) {}
+    ~SlotOwner() {
+      slot->epoch = 0;
+      slot->depth = 0;
+      __atomic_store_n(&slot->used, 0, __ATOMIC_RELEASE);
+    }
+  };
+
+public:
+  class Guard {
+    Slot *m_slot;
+
+  public:
+    Guard() : m_slot(enter()) {}
+    ~Guard() {
+      if (--m_slot->depth == 0) {
+        __atomic_store_n(&m_slot->epoch, 0, __ATOMIC_RELEASE);
+      }
+    }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+  };
+
+  static uint64_t current() { return state().epoch; }
+
+  // 所有读取中的线程都已看到当前 epoch 时前进一步，返回当前的 epoch
+  static uint64_t tryAdvance() {
+    State &s = state();
+    // 与 enter 中的屏障配对：之前摘下的内存对之后进入的读者不可见
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t epoch = s.epoch;
+    for (Slot *p = s.head; p != nullptr; p = p->next) {
+      uint64_t e = p->epoch;
+      if (e != 0 && e != epoch) {
+        return epoch;
+      }
+    }
+    Atomic::CAS(&s.epoch, epoch, epoch + 1);
+    return s.epoch;
   }
 
+  // 在 tag 时释放的内存，当前 epoch 为 epoch 时是否可以重新使用
+  static bool isSafe(uint64_t tag, uint64_t epoch) { return tag + 2 <= epoch; }
+
 private:
-  void put(int index, const T &v, uint32_t hashCode) {
-    // call put before m_count is increased
-    // assert(index < m_count);
-    if (index < MAX_COUNT_PER_NODE) {
-      m_values[index] = v;
-      m_codes[index] = hashCode;
+  static Slot *enter() {
+    Slot *slot = localSlot();
+    if (slot->depth++ == 0) {
+      // 先公布 epoch 再读取节点（store-load 需要完整的屏障，x86 上 xchg
+      // 比 store + mfence 便宜，槽位只由本线程写，没有竞争）。公布的 epoch
+      // 即使已经过时，也会阻止全局 epoch 前进，之后摘下的内存不会被重用
+      __atomic_exchange_n(&slot->epoch, state().epoch, __ATOMIC_SEQ_CST);
+    }
+    return slot;
+  }
+
+  static Slot *localSlot() {
+    static thread_local Slot *slot = nullptr;
+    if (slot == nullptr) {
+      slot = acquireSlot();
+      static thread_local SlotOwner owner(slot);
+    }
+    return slot;
+  }
+
+  static Slot *acquireSlot() {
+    // 优先重用已退出线程的槽位，否则新建并加入链表头
+    State &s = state();
+    for (Slot *p = s.head; p != nullptr; p = p->next) {
+      if (p->used == 0 && Atomic::CAS(&p->used, 0, 1)) {
+        return p;
+      }
+    }
+    Slot *slot = new Slot();
+    slot->used = 1;
+    Slot *head;
+    do {
+      head = s.head;
+      slot->next = head;
+    } while (!Atomic::CAS(&s.head, head, slot));
+    return slot;
+  }
+};
+
+class CStripedCounter {
+  // 线程安全版本中的计数：按线程序号累加到分散的缓存行，每行累计超过
+  // COUNTER_BATCH 时并入总数。approx() 只读总数（误差不超过 MAX_ERROR），
+  // sum() 加上各行未并入的部分，没有并发修改时是准确的
+  struct Stripe {
+    volatile int64_t pending;
+    char padding[64 - sizeof(int64_t)];
+  };
+
+  volatile int64_t m_total{0};
+  Stripe m_stripes[COUNTER_STRIPES];
+
+public:
+  static const int64_t MAX_ERROR = (int64_t)COUNTER_STRIPES * COUNTER_BATCH;
+
+  CStripedCounter() { reset(0); }
+
+  void add(int64_t delta, bool cocurrent) {
+    if (!cocurrent) {
+      m_total += delta;
+      return;
+    }
+    Stripe &stripe = m_stripes[Atomic::ThreadSlot() % COUNTER_STRIPES];
+    int64_t v = __sync_add_and_fetch(&stripe.pending, delta);
+    if (v >= COUNTER_BATCH || v <= -COUNTER_BATCH) {
+      __sync_fetch_and_add(&stripe.pending, -v);
+      __sync_fetch_and_add(&m_total, v);
+    }
+  }
+
+  int64_t approx() const { return m_total; }
+
+  int64_t sum() const {
+    int64_t total = m_total;
+    for (int i = 0; i < COUNTER_STRIPES; i++) {
+      total += m_stripes[i].pending;
+    }
+    return total;
+  }
+
+  void reset(int64_t value) {
+    m_total = value;
+    for (int i = 0; i < COUNTER_STRIPES; i++) {
+      m_stripes[i].pending = 0;
+    }
+  }
+};
+
+class CBufferManager {
+  // 数据（节点的扩展内存）的分配器：数据块（DATA_CHUNK_SIZE）由所有 arena
+  // 共享，每个 arena 每次从数据块中取一段（ARENA_BLOCK_SIZE）顺序分配，并有
+  // 各自的回收列表。线程安全版本中，各线程按线程序号使用不同的 arena，
+  // 只在取新的一段时需要 m_mutex；线程不安全版本只有一个 arena，不加锁
+
+  using AutoLock = CAutoLock<std::mutex>;
+
+  // 按 log2(size) 直接索引。同一个分区中的大小均为 (固定值 * 2^n)，
+  // 因此每个 log2 只对应一个大小，size 记录该大小
+  struct SizeItem {
+    int size{0};
+    std::vector<unsigned char *> free; // 可以重新使用的内存
+    // 线程安全版本中刚释放的内存及释放时的 epoch（见 CEpoch），按 epoch 排序
+    std::vector<std::pair<uint64_t, unsigned char *>> retired;
+  };
+
+  struct Arena {
+    std::mutex mutex;
+    unsigned char *pos{nullptr}; // 当前段中未分配的部分
+    unsigned char *end{nullptr};
+    SizeItem recyclers[SIZE_CLASS_COUNT];
+  };
+
+  Arena *m_arenas{nullptr};
+  int m_arenaCount{1};
+  std::vector<unsigned char *> m_chunks;
+  std::vector<unsigned char *> m_externalChunks; // 快照映射的数据块，不释放
+  std::vector<unsigned char *> m_regions;     // 实际申请的内存（含多个数据块）
+  std::vector<unsigned char *> m_spareChunks; // 已申请尚未使用的数据块
+  int m_usedPos{0};
+  size_t m_discarded{0}; // 换段或换数据块时丢弃的尾部及不能回收的内存
+  bool m_cocurrent;
+  AllocPolicy m_policy;
+  int m_partIndex{0};
+
+#ifdef _LOG_FOR_METRICS
+  struct {
+    int alloc_count;
+    int max_alloc_size;
+  } m_matrics{0, 0};
+#endif
+
+  std::mutex m_mutex; // 保护 m_chunks、m_usedPos 及 m_discarded
+
+public:
+  CBufferManager(bool cocurrent, int arenaCount = DEF_ARENA_COUNT,
+                 const AllocPolicy &policy = AllocPolicy(), int partIndex = 0)
+      : m_cocurrent(cocurrent), m_policy(policy), m_partIndex(partIndex) {
+    m_arenaCount = cocurrent && arenaCount > 1 ? arenaCount : 1;
+    m_arenas = new Arena[m_arenaCount];
+  }
+
+  ~CBufferManager() {
+    clear();
+    delete[] m_arenas;
+  }
+
+  unsigned char *alloc(int size) {
+    assert(size < (1 << 16));
+
+    return _alloc(size);
+  }
+
+  void dealloc(unsigned char *buf, int size) { return _dealloc(buf, size); }
+
+  // 全部数据块：先是外部数据块，之后为自身申请的数据块（快照使用）
+  void getChunks(std::vector<unsigned char *> &chunks) const {
+    chunks = m_externalChunks;
+    chunks.insert(chunks.end(), m_chunks.begin(), m_chunks.end());
+  }
+
+  // 加入一个数据块（快照加载使用）。external 为空时申请一个新的数据块，
+  // 否则使用外部的内存（clear 时不释放）。返回数据块的地址
+  unsigned char *addChunk(unsigned char *external) {
+    if (external != nullptr) {
+      m_externalChunks.push_back(external);
+      return external;
+    }
+    allocChunk();
+    // 已有数据块均视为用完，之后从新的数据块中申请
+    m_usedPos = DATA_CHUNK_SIZE;
+    return m_chunks.back();
+  }
+
+  void clear() {
+    if (m_cocurrent) {
+      AutoLock lock(&m_mutex);
+      return _clear();
     } else {
-      m_pValues[index - MAX_COUNT_PER_NODE] = v;
-      ((uint32_t *)(m_pValues + m_capacity))[index - MAX_COUNT_PER_NODE] =
-          hashCode;
+      return _clear();
+    }
+  }
+
+  // 统计内存占用，加到 usage 中（不含快照映射的数据块）。可与 alloc/dealloc
+  // 并发
+  void getMemoryUsage(MemoryUsage &usage) {
+    if (m_cocurrent) {
+      m_mutex.lock();
+    }
+    size_t regionBytes =
+        CPageAllocator::getAllocSize(getRegionSize(), m_policy);
+    usage.dataChunks += m_regions.size() * regionBytes;
+    usage.wastedTail += m_discarded + m_spareChunks.size() * DATA_CHUNK_SIZE;
+    if (!m_chunks.empty()) {
+      usage.wastedTail += DATA_CHUNK_SIZE - m_usedPos;
+    }
+    usage.overhead += sizeof(*this) + sizeof(Arena) * m_arenaCount;
+    usage.overhead += sizeof(unsigned char *) *
+                      (m_chunks.capacity() + m_externalChunks.capacity() +
+                       m_regions.capacity() + m_spareChunks.capacity());
+    if (m_cocurrent) {
+      m_mutex.unlock();
+    }
+
+    for (int i = 0; i < m_arenaCount; i++) {
+      Arena *arena = &m_arenas[i];
+      lockArena(arena);
+      usage.wastedTail += arena->end - arena->pos;
+      for (int k = 0; k < SIZE_CLASS_COUNT; k++) {
+        SizeItem *item = &arena->recyclers[k];
+        usage.freeLists +=
+            item->size * (item->free.size() + item->retired.size());
+        usage.overhead += sizeof(unsigned char *) * item->free.capacity() +
+                          sizeof(item->retired[0]) * item->retired.capacity();
+      }
+      unlockArena(arena);
+    }
+  }
+
+  void dump_stat(const char *msg) {
+    int sizes[SIZE_CLASS_COUNT]{0};
+    int count = 0;
+    for (int i = 0; i < SIZE_CLASS_COUNT; i++) {
+      for (int k = 0; k < m_arenaCount && sizes[i] == 0; k++) {
+        sizes[i] = m_arenas[k].recyclers[i].size;
+      }
+      count += sizes[i] != 0;
+    }
+#ifdef _LOG_FOR_METRICS
+    LOG_INFO(
+        "%s mem: chunks=%ld, alloc_count=%d, max_size=%d, diff_size=%d: [",
+        msg, m_chunks.size(), m_matrics.alloc_count, m_matrics.max_alloc_size,
+        count);
+#else
+    LOG_INFO("%s mem: chunks=%ld, diff_size=%d: [", msg, m_chunks.size(),
+             count);
+#endif
+    const char *sep = "";
+    for (int i = 0; i < SIZE_CLASS_COUNT; i++) {
+      if (sizes[i] != 0) {
+        LOG_INFO("%s%d", sep, sizes[i]);
+        sep = ",";
+      }
+    }
+    LOG_INFO("]\n");
+  }
+
+private:
+  unsigned char *_alloc(int size) {
+#ifdef _LOG_FOR_METRICS
+    if (m_cocurrent)
+      m_mutex.lock();
+    m_matrics.alloc_count++;
+    if (m_matrics.max_alloc_size < size)
+      m_matrics.max_alloc_size = size;
+    if (m_cocurrent)
+      m_mutex.unlock();
+#endif
+    Arena *arena = getArena();
+    lockArena(arena);
+    SizeItem *item = &arena->recyclers[getSizeClass(size)];
+    if (item->size == size && item->free.empty() && !item->retired.empty()) {
+      reclaim(item, CEpoch::current());
+    }
+    if (item->size == size && item->free.size() > 0) {
+      unsigned char *buf = item->free.back();
+      item->free.pop_back();
+      unlockArena(arena);
+      return buf;
+    }
+
+    // alloc from current block of arena
+    if (arena->pos + size > arena->end) {
+      allocBlock(arena);
+    }
+    unsigned char *buf = arena->pos;
+    arena->pos += size;
+    unlockArena(arena);
+    return buf;
+  }
+
+  void _dealloc(unsigned char *buf, int count) {
+    Arena *arena = getArena();
+    lockArena(arena);
+    SizeItem *item = &arena->recyclers[getSizeClass(count)];
+    if (item->size == 0) {
+      item->size = count;
+    }
+    if (item->size != count) {
+      // 同一 log2 出现了不同的大小：各节点的扩展内存均为固定值 * 2^n，
+      // 不应该发生。release 版本中不回收，计入丢弃的部分（memoryUsage 可见）
+      assert(item->size == count);
+      unlockArena(arena);
+      if (m_cocurrent) {
+        AutoLock lock(&m_mutex);
+        m_discarded += count;
+      } else {
+        m_discarded += count;
+      }
+      return;
+    }
+    if (!m_cocurrent) {
+      // 没有并发的读者，可以直接重新使用
+      item->free.push_back(buf);
+    } else {
+      // 不加锁的读者可能仍在读取，等到之前进入的读者都离开后再重新使用
+      item->retired.push_back(std::make_pair(CEpoch::current(), buf));
+      if (item->retired.size() % EPOCH_RECLAIM_BATCH == 0) {
+        reclaim(item, CEpoch::tryAdvance());
+      }
+    }
+    unlockArena(arena);
+  }
+
+  void reclaim(SizeItem *item, uint64_t epoch) {
+    // 把已经安全的内存移到 free（retired 按 epoch 排序）
+    size_t count = 0;
+    while (count < item->retired.size() &&
+           CEpoch::isSafe(item->retired[count].first, epoch)) {
+      item->free.push_back(item->retired[count].second);
+      count++;
+    }
+    item->retired.erase(item->retired.begin(),
+                        item->retired.begin() + count);
+  }
+
+  void _clear() {
+    for (auto it = m_regions.begin(); it != m_regions.end(); ++it) {
+      CPageAllocator::release(*it, getRegionSize(), m_policy);
+    }
+    m_regions.clear();
+    m_spareChunks.clear();
+    m_chunks.clear();
+    m_externalChunks.clear();
+    m_discarded = 0;
+
+    for (int i = 0; i < m_arenaCount; i++) {
+      Arena *arena = &m_arenas[i];
+      arena->pos = arena->end = nullptr;
+      for (int k = 0; k < SIZE_CLASS_COUNT; k++) {
+        SizeItem *item = &arena->recyclers[k];
+        item->size = 0;
+        std::vector<unsigned char *>().swap(item->free);
+        std::vector<std::pair<uint64_t, unsigned char *>>().swap(
+            item->retired);
+      }
+    }
+    m_usedPos = 0;
+
+#ifdef _LOG_FOR_METRICS
+    memset(&m_matrics, 0, sizeof(m_matrics));
+#endif
+  }
+
+  void allocChunk() {
+    if (m_spareChunks.empty()) {
+      int regionSize = getRegionSize();
+      unsigned char *p = (unsigned char *)CPageAllocator::alloc(
+          regionSize, m_policy, m_partIndex, false);
+      if (p == nullptr) {
+        throw std::bad_alloc();
+      }
+      m_regions.push_back(p);
+      for (int off = regionSize - DATA_CHUNK_SIZE; off >= 0;
+           off -= DATA_CHUNK_SIZE) {
+        m_spareChunks.push_back(p + off);
+      }
+    }
+    m_chunks.push_back(m_spareChunks.back());
+    m_spareChunks.pop_back();
+    m_usedPos = 0;
+  }
+
+  int getRegionSize() const {
+    // 使用大页时，每次申请一个大页（多个数据块）
+    bool huge = m_policy.hugePage != HUGE_PAGE_NONE;
+    return huge && HUGE_PAGE_SIZE > DATA_CHUNK_SIZE ? HUGE_PAGE_SIZE
+                                                    : DATA_CHUNK_SIZE;
+  }
+
+  void allocBlock(Arena *arena) {
+    // 从数据块中为 arena 取一段，只有一个 arena 时取整个数据块。
+    // 原来段中剩余的部分不再使用
+    int blockSize = m_arenaCount == 1 ? DATA_CHUNK_SIZE : ARENA_BLOCK_SIZE;
+    if (m_cocurrent)
+      m_mutex.lock();
+    m_discarded += arena->end - arena->pos;
+    if (m_chunks.size() == 0 || m_usedPos + blockSize > DATA_CHUNK_SIZE) {
+      if (m_chunks.size() > 0) {
+        m_discarded += DATA_CHUNK_SIZE - m_usedPos;
+      }
+      allocChunk();
+    }
+    arena->pos = m_chunks.back() + m_usedPos;
+    arena->end = arena->pos + blockSize;
+    m_usedPos += blockSize;
+    if (m_cocurrent)
+      m_mutex.unlock();
+  }
+
+  static int getSizeClass(int size) { return 31 - __builtin_clz(size); }
+
+  Arena *getArena() {
+    if (m_arenaCount == 1) {
+      return m_arenas;
+    }
+    return &m_arenas[Atomic::ThreadSlot() % m_arenaCount];
+  }
+
+  void lockArena(Arena *arena) {
+    if (m_cocurrent) {
+      arena->mutex.lock();
+    }
+  }
+
+  void unlockArena(Arena *arena) {
+    if (m_cocurrent) {
+      arena->mutex.unlock();
+    }
+  }
+};
+
+class HashNodeBase {
+protected:
+  volatile uint32_t m_lock; // 同时是节点的版本号（seqlock），奇数时已加锁
+  uint16_t m_count;
+  uint16_t m_capacity;
+
+public:
+  uint16_t getCount() const { return m_count; }
+
+  void lock() { SpinnedLock::doSeqLock(&m_lock); }
+
+  void unlock() { SpinnedLock::doSeqUnlock(&m_lock); }
+
+  // 不加锁读取：readBegin 等待写入结束并返回版本号，读取之后 readRetry
+  // 返回 true 时表示读取期间有写入（add/remove/split），读到的结果无效。
+  // 读取时需按写入相反的顺序取个数、容量及数据块指针，避免越界
+  uint32_t readBegin() const {
+    int round = 0;
+    uint32_t version;
+    while ((version = m_lock) & 1) {
+      // 读者不休眠：解锁时只唤醒一个加锁的线程
+      if (!SpinnedLock::spin(&m_lock, version, round)) {
+        std::this_thread::yield();
+      }
+    }
+    Atomic::LoadBarrier();
+    return version;
+  }
+
+  bool readRetry(uint32_t version) const {
+    Atomic::LoadBarrier();
+    return m_lock != version;
+  }
+};
+
+template <class T> class FixedSizeHashNode : public HashNodeBase {
+  const static int DATA_ITEM_SIZE = (sizeof(uint32_t) + sizeof(T));
+
+  using HashNode = FixedSizeHashNode<T>;
+
+private:
+  T *m_pValues;
+  struct {
+    T m_values[MAX_COUNT_PER_NODE];
+    uint32_t m_codes[MAX_COUNT_PER_NODE];
+  };
+
+public:
+  T getValue(int index) const {
+    if (index < MAX_COUNT_PER_NODE) {
+      return m_values[index];
+    } else {
+      return m_pValues[index - MAX_COUNT_PER_NODE];
+    }
+  }
+
+  uint32_t getCode(int index) const {
+    if (index < MAX_COUNT_PER_NODE) {
+      return m_codes[index];
+    } else {
+      return ((uint32_t *)(m_pValues + m_capacity))[index - MAX_COUNT_PER_NODE];
+    }
+  }
+
+  int32_t find(const T &v, uint32_t hashCode) const {
+    // 先批量比较 hashCode（SIMD），仅在 hashCode 相同时比较数据
+    int count = m_count;
+    int local = count < MAX_COUNT_PER_NODE ? count : MAX_COUNT_PER_NODE;
+    int32_t index = CodeProbe::find(m_codes, m_values, local,
+                                    MAX_COUNT_PER_NODE, v, hashCode);
+    if (index >= 0 || count <= MAX_COUNT_PER_NODE) {
+      return index;
+    }
+    // 扩容时先写指针再写容量：先取容量，取到的指针不会比容量旧
+    int capacity = m_capacity;
+    Atomic::LoadBarrier();
+    T *pValues = m_pValues;
+    if (count - MAX_COUNT_PER_NODE > capacity) {
+      return -1; // 不加锁读取时与写入交错，由 readRetry 重试
+    }
+    index = CodeProbe::find((uint32_t *)(pValues + capacity), pValues,
+                            count - MAX_COUNT_PER_NODE, capacity, v, hashCode);
+    return index < 0 ? index : index + MAX_COUNT_PER_NODE;
+  }
+
+  int32_t find(const T &v) const {
+    // 逐个比较数据（不使用 hashCode）
+    // lockup local-item
+    int count = m_count < MAX_COUNT_PER_NODE ? m_count : MAX_COUNT_PER_NODE;
+    for (int i = 0; i < count; i++) {
+      if (m_values[i] == v) {
+        return i;
+      }
+    }
+    count = m_count - MAX_COUNT_PER_NODE;
+    for (int i = 0; i < count; i++) {
+      if (m_pValues[i] == v) {
+        return i + MAX_COUNT_PER_NODE;
+      }
+    }
+    return -1;
+  }
+
+  bool remove(const T &v, uint32_t hashCode) {
+    int index = find(v, hashCode);
+    if (index < 0) {
+      return false;
+    }
+    if (index < m_count - 1) {
+      // 删除中间的，则需要把原先的最后一个，代替到当前位置
+      put(index, getValue(m_count - 1), getCode(m_count - 1));
+    }
+
+    m_count--;
+    return true;
+  }
+
+  bool safeAdd(CBufferManager *pBufMgr, const T &v, uint32_t hashCode) {
+    if (this->find(v, hashCode) >= 0) {
+      return false;
+    }
+    int capacity = 0;
+    if (m_capacity == 0 && m_count == MAX_COUNT_PER_NODE) {
+      // 首次扩容
+      capacity = MAX_COUNT_PER_NODE;
+      m_pValues = (T *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
+      m_capacity = capacity;
+    } else if (m_count == MAX_COUNT_PER_NODE + m_capacity) {
+      // 已有扩展内存块，扩容
+      capacity = m_capacity * 2;
+      T *pValues = (T *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
+      memcpy(pValues, m_pValues, sizeof(T) * (m_capacity));
+      memcpy(pValues + capacity, m_pValues + m_capacity,
+             sizeof(uint32_t) * m_capacity);
+
+      unsigned char *pOldBuf = (unsigned char *)m_pValues;
+      int bufLen = m_capacity * DATA_ITEM_SIZE;
+
+      m_pValues = pValues;
+      m_capacity = capacity;
+
+      // delay dealloc here, when node is ready (for thread-safe)
+      pBufMgr->dealloc(pOldBuf, bufLen);
+    }
+    put(m_count, v, hashCode);
+    m_count++;
+    return true;
+  }
+
+  // 溢出的数据块（快照使用），无数据块时返回空
+  unsigned char *getBuffer() const {
+    return m_capacity ? (unsigned char *)m_pValues : nullptr;
+  }
+
+  void setBuffer(unsigned char *buf) { m_pValues = (T *)buf; }
+
+  // 把扩展内存复制到 pBufMgr 中可以容纳现有数据的最小内存块（收缩使用）。
+  // 原来的内存块不归还，由调用者整体释放
+  void repack(CBufferManager *pBufMgr) {
+    int extra = m_count - MAX_COUNT_PER_NODE;
+    if (extra <= 0) {
+      m_capacity = 0;
+      return;
+    }
+    int capacity = MAX_COUNT_PER_NODE;
+    while (capacity < extra) {
+      capacity *= 2;
+    }
+    T *pValues = (T *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
+    memcpy(pValues, m_pValues, sizeof(T) * extra);
+    memcpy(pValues + capacity, m_pValues + m_capacity,
+           sizeof(uint32_t) * extra);
+    m_pValues = pValues;
+    m_capacity = capacity;
+  }
+
+  int split(CBufferManager *pBufMgr, HashNode *other, int capacity) {
+    // 在rehash时，运行并行加入的同样数据，加入到新节点或老节点，因此这里返回
+    // 迁移节点时的重复个数
+    int newCount = 0;
+    int dupCount = 0;
+    for (int index = 0; index < m_count; index++) {
+      uint32_t hashCode = getCode(index);
+      T v = getValue(index);
+      if (hashCode & capacity) {
+        if (!other->safeAdd(pBufMgr, v, hashCode)) {
+          dupCount++;
+        }
+      } else {
+        if (index != newCount) {
+          // move forward
+          put(newCount, v, hashCode);
+        }
+        newCount++;
+      }
+    }
+    m_count = newCount;
+    return dupCount;
+  }
+
+  void dump(const char *msg) const {
+    LOG_INFO("%s: Node_%p:(lock=%u,cap=%d,cnt=%d):", msg, this, m_lock,
+             m_capacity, m_count);
+    for (int i = 0; i < m_count; i++) {
+      LOG_INFO(" %x", getCode(i));
+    }
+    LOG_INFO("\n");
+  }
+
+  bool debug_verify(int hashIndex, int hashMask) const {
+    for (int i = 0; i < m_count; i++) {
+      if (!debug_verify(hashIndex, hashMask, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool debug_verify(int hashIndex, int hashMask, int item) const {
+    uint32_t hashCode = getCode(item);
+    int expectedIndex = hashCode & hashMask;
+    if (expectedIndex != hashIndex) {
+      char buf[256] = {0};
+      sprintf(buf, "inconsist hash value: %x: (%x & %x) != %x, diff=%x",
+              expectedIndex, hashCode, hashMask, hashIndex,
+              expectedIndex ^ hashIndex);
+      dump(buf);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  void put(int index, const T &v, uint32_t hashCode) {
+    // call put before m_count is increased
+    // assert(index < m_count);
+    if (index < MAX_COUNT_PER_NODE) {
+      m_values[index] = v;
+      m_codes[index] = hashCode;
+    } else {
+      m_pValues[index - MAX_COUNT_PER_NODE] = v;
+      ((uint32_t *)(m_pValues + m_capacity))[index - MAX_COUNT_PER_NODE] =
+          hashCode;
+    }
+  }
+};
+
+// 整数数据的紧凑节点：不保存 hashCode（比较数据本身，需要时由 Hasher 重新
+// 计算），数据按 Stored 保存（如 uint64_t 的 id 不超过 32 位时使用 uint32_t）。
+// FixedSizeHashNode<uint64_t> 每项 12 字节、节点 64 字节，
+// CompactHashNode<uint64_t, uint32_t> 每项 4 字节、节点 32 字节。
+// 超出 Stored 范围的数据不能加入（safeAdd 返回 false）
+template <class T, class Stored = T, class Hasher = CalcHash>
+class CompactHashNode : public HashNodeBase {
+  static_assert(std::is_integral<T>::value && std::is_integral<Stored>::value &&
+                    sizeof(Stored) <= sizeof(T),
+                "CompactHashNode needs integer values");
+  const static int DATA_ITEM_SIZE = sizeof(Stored);
+
+  using HashNode = CompactHashNode<T, Stored, Hasher>;
+
+private:
+  Stored *m_pValues;
+  Stored m_values[MAX_COUNT_PER_NODE];
+
+public:
+  static bool fits(const T &v) { return (T)(Stored)v == v; }
+
+  T getValue(int index) const {
+    if (index < MAX_COUNT_PER_NODE) {
+      return (T)m_values[index];
+    } else {
+      return (T)m_pValues[index - MAX_COUNT_PER_NODE];
+    }
+  }
+
+  uint32_t getCode(int index) const { return Hasher::get(getValue(index)); }
+
+  int32_t find(const T &v, uint32_t hashCode) const { return find(v); }
+
+  int32_t find(const T &v) const {
+    if (!fits(v)) {
+      return -1;
+    }
+    Stored key = (Stored)v;
+    int count = m_count;
+    int local = count < MAX_COUNT_PER_NODE ? count : MAX_COUNT_PER_NODE;
+    int32_t index = probe(m_values, local, MAX_COUNT_PER_NODE, key);
+    if (index >= 0 || count <= MAX_COUNT_PER_NODE) {
+      return index;
+    }
+    // 与 FixedSizeHashNode 相同，先取容量再取指针
+    int capacity = m_capacity;
+    Atomic::LoadBarrier();
+    Stored *pValues = m_pValues;
+    if (count - MAX_COUNT_PER_NODE > capacity) {
+      return -1;
+    }
+    index = probe(pValues, count - MAX_COUNT_PER_NODE, capacity, key);
+    return index < 0 ? index : index + MAX_COUNT_PER_NODE;
+  }
+
+  bool remove(const T &v, uint32_t hashCode) {
+    int index = find(v);
+    if (index < 0) {
+      return false;
+    }
+    if (index < m_count - 1) {
+      // 删除中间的，则需要把原先的最后一个，代替到当前位置
+      put(index, getValue(m_count - 1));
+    }
+
+    m_count--;
+    return true;
+  }
+
+  bool safeAdd(CBufferManager *pBufMgr, const T &v, uint32_t hashCode) {
+    if (!fits(v) || this->find(v) >= 0) {
+      return false;
+    }
+    if (m_capacity == 0 && m_count == MAX_COUNT_PER_NODE) {
+      // 首次扩容
+      m_pValues = (Stored *)pBufMgr->alloc(MAX_COUNT_PER_NODE * DATA_ITEM_SIZE);
+      m_capacity = MAX_COUNT_PER_NODE;
+    } else if (m_count == MAX_COUNT_PER_NODE + m_capacity) {
+      // 已有扩展内存块，扩容
+      int capacity = m_capacity * 2;
+      Stored *pValues = (Stored *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
+      memcpy(pValues, m_pValues, sizeof(Stored) * m_capacity);
+
+      unsigned char *pOldBuf = (unsigned char *)m_pValues;
+      int bufLen = m_capacity * DATA_ITEM_SIZE;
+
+      m_pValues = pValues;
+      m_capacity = capacity;
+
+      // delay dealloc here, when node is ready (for thread-safe)
+      pBufMgr->dealloc(pOldBuf, bufLen);
+    }
+    put(m_count, v);
+    m_count++;
+    return true;
+  }
+
+  // 溢出的数据块（快照使用），无数据块时返回空
+  unsigned char *getBuffer() const {
+    return m_capacity ? (unsigned char *)m_pValues : nullptr;
+  }
+
+  void setBuffer(unsigned char *buf) { m_pValues = (Stored *)buf; }
+
+  // 与 FixedSizeHashNode::repack 相同
+  void repack(CBufferManager *pBufMgr) {
+    int extra = m_count - MAX_COUNT_PER_NODE;
+    if (extra <= 0) {
+      m_capacity = 0;
+      return;
+    }
+    int capacity = MAX_COUNT_PER_NODE;
+    while (capacity < extra) {
+      capacity *= 2;
+    }
+    Stored *pValues = (Stored *)pBufMgr->alloc(capacity * DATA_ITEM_SIZE);
+    memcpy(pValues, m_pValues, sizeof(Stored) * extra);
+    m_pValues = pValues;
+    m_capacity = capacity;
+  }
+
+  int split(CBufferManager *pBufMgr, HashNode *other, int capacity) {
+    // 与 FixedSizeHashNode::split 相同，hashCode 重新计算
+    int newCount = 0;
+    int dupCount = 0;
+    for (int index = 0; index < m_count; index++) {
+      T v = getValue(index);
+      uint32_t hashCode = Hasher::get(v);
+      if (hashCode & capacity) {
+        if (!other->safeAdd(pBufMgr, v, hashCode)) {
+          dupCount++;
+        }
+      } else {
+        if (index != newCount) {
+          // move forward
+          put(newCount, v);
+        }
+        newCount++;
+      }
+    }
+    m_count = newCount;
+    return dupCount;
+  }
+
+  void dump(const char *msg) const {
+    LOG_INFO("%s: Node_%p:(lock=%u,cap=%d,cnt=%d):", msg, this, m_lock,
+             m_capacity, m_count);
+    for (int i = 0; i < m_count; i++) {
+      LOG_INFO(" %x", getCode(i));
+    }
+    LOG_INFO("\n");
+  }
+
+  bool debug_verify(int hashIndex, int hashMask) const {
+    for (int i = 0; i < m_count; i++) {
+      if (!debug_verify(hashIndex, hashMask, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool debug_verify(int hashIndex, int hashMask, int item) const {
+    uint32_t hashCode = getCode(item);
+    int expectedIndex = hashCode & hashMask;
+    if (expectedIndex != hashIndex) {
+      char buf[256] = {0};
+      sprintf(buf, "inconsist hash value: %x: (%x & %x) != %x, diff=%x",
+              expectedIndex, hashCode, hashMask, hashIndex,
+              expectedIndex ^ hashIndex);
+      dump(buf);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static int32_t probe(const uint32_t *values, int count, int readable,
+                       uint32_t key) {
+    // 32 位的数据直接按 hashCode 的方式批量比较（SIMD）
+    return CodeProbe::find(values, values, count, readable, key, key);
+  }
+
+  template <class S>
+  static int32_t probe(const S *values, int count, int readable, S key) {
+    for (int i = 0; i < count; i++) {
+      if (values[i] == key) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void put(int index, const T &v) {
+    // call put before m_count is increased
+    if (index < MAX_COUNT_PER_NODE) {
+      m_values[index] = (Stored)v;
+    } else {
+      m_pValues[index - MAX_COUNT_PER_NODE] = (Stored)v;
+    }
+  }
+};
+
+class SliceHashNode : public HashNodeBase {
+
+  using HashNode = SliceHashNode;
+
+  struct ItemInfo {
+    uint32_t code;
+    uint16_t len; //
+    uint16_t off; // 从尾部计算的距离，（使得可以整块负责数据）
+  };
+
+private:
+  unsigned char *m_pBuffer; // Info1, 2, ..., (..free..) (m_offset)..., Data1
+  uint32_t m_usedSpace;     // 以及占用的空间
+
+public:
+  Slice getValue(int index) const {
+    ItemInfo *pItem = getItem(index);
+    return Slice{pItem->len, m_pBuffer + m_capacity - pItem->off};
+  }
+
+  uint32_t getCode(int index) const {
+    const ItemInfo *pItem = getItem(index);
+    return pItem->code;
+  }
+
+  int32_t find(const Slice &v, uint32_t hashCode) const {
+    // 不加锁读取时：先取个数、容量，再取指针（与写入顺序相反）；
+    // 与写入交错时 off 可能与 len 不匹配，不比较（由 readRetry 重试）
+    int count = m_count;
+    int capacity = m_capacity;
+    Atomic::LoadBarrier();
+    unsigned char *pBuffer = m_pBuffer;
+    for (int i = 0; i < count; i++) {
+      ItemInfo item = ((ItemInfo *)pBuffer)[i];
+      if (item.code == hashCode && v.len == item.len && item.off >= item.len &&
+          memcmp(pBuffer + capacity - item.off, v.buf, item.len) == 0)
+        return i;
+    }
+    return -1;
+  }
+
+  int32_t find(const Slice &v) const {
+    for (int i = 0; i < m_count; i++) {
+      ItemInfo *pItem = getItem(i);
+      if (v.len == pItem->len &&
+          memcmp(m_pBuffer + m_capacity - pItem->off, v.buf, pItem->len) == 0)
+        return i;
+    }
+    return -1;
+  }
+
+  bool remove(const Slice &v, uint32_t hashCode) {
+    int index = find(v, hashCode);
+    if (index < 0) {
+      return false;
+    }
+    if (index < m_count - 1) {
+      // 删除中间的，把最后一个 itemInfo填写到当前位置
+      // 其余内存不做修改和移动（被删除的数据留在原处，分裂或收缩时回收）
+      ItemInfo *p = getItem(index);
+      *p = *getItem(m_count - 1);
+    }
+
+    m_count--;
+    return true;
+  }
+
+  bool safeAdd(CBufferManager *pBufMgr, const Slice &v, uint32_t hashCode) {
+    if (this->find(v, hashCode) >= 0) {
+      return false;
+    }
+    int needSpace = sizeof(ItemInfo) + getAlignedSize(v.len) + getUsedSpace();
+    if (m_capacity == 0) {
+      int capacity = calcNeedCapacity(needSpace);
+      m_pBuffer = pBufMgr->alloc(capacity);
+      m_capacity = capacity;
+    } else if (m_capacity < needSpace) {
+      // 已有扩展内存块，需要扩容
+      int capacity = calcNeedCapacity(needSpace);
+      unsigned char *pBuffer = pBufMgr->alloc(capacity);
+      // 复制现有数据。（记录的offset为从尾部开始计算，因此相对位置不变，无需逐项更新）
+      memcpy(pBuffer + capacity - m_usedSpace,
+             m_pBuffer + m_capacity - m_usedSpace, m_usedSpace);
+      // 复制DataItem信息。（尾部对齐）
+      memcpy(pBuffer, m_pBuffer, m_count * sizeof(ItemInfo));
+
+      unsigned char *pOldBuf = m_pBuffer;
+      int bufLen = m_capacity;
+
+      m_pBuffer = pBuffer;
+      m_capacity = capacity;
+
+      // delay dealloc here, when node is ready (for thread-safe)
+      pBufMgr->dealloc(pOldBuf, bufLen);
+    }
+    put(m_count, v, hashCode, m_usedSpace);
+    m_count++;
+    return true;
+  }
+
+  // 数据块（快照使用），无数据块时返回空
+  unsigned char *getBuffer() const { return m_capacity ? m_pBuffer : nullptr; }
+
+  void setBuffer(unsigned char *buf) { m_pBuffer = buf; }
+
+  // 按现有数据重新排列到 pBufMgr 中的最小内存块，去掉 remove 留下的空洞
+  // （收缩使用）。原来的内存块不归还，由调用者整体释放
+  void repack(CBufferManager *pBufMgr) {
+    if (m_count == 0) {
+      m_capacity = 0;
+      m_usedSpace = 0;
+      return;
+    }
+    int needSpace = sizeof(ItemInfo) * m_count;
+    for (int index = 0; index < m_count; index++) {
+      needSpace += getAlignedSize(getItem(index)->len);
+    }
+    unsigned char *pOldBuf = m_pBuffer;
+    int oldCapacity = m_capacity;
+    int capacity = 64;
+    while (capacity < needSpace) {
+      capacity = capacity << 1;
+    }
+    m_pBuffer = pBufMgr->alloc(capacity);
+    m_capacity = capacity;
+    uint32_t usedSpace = 0;
+    for (int index = 0; index < m_count; index++) {
+      ItemInfo info = ((ItemInfo *)pOldBuf)[index];
+      Slice v{info.len, pOldBuf + oldCapacity - info.off};
+      put(index, v, info.code, usedSpace);
+    }
+    m_usedSpace = usedSpace;
+  }
+
+  int split(CBufferManager *pBufMgr, HashNode *other, int capacity) {
+    // 在rehash时，运行并行加入的同样数据，加入到新节点或老节点，因此这里返回
+    // 迁移节点时的重复个数
+    int newCount = 0;
+    int dupCount = 0;
+    Slice v;
+    for (int index = 0; index < m_count; index++) {
+      ItemInfo *pInfo = getItem(index);
+      if (pInfo->code & capacity) {
+        v.len = pInfo->len;
+        v.buf = getValuePtr(pInfo);
+        if (!other->safeAdd(pBufMgr, v, pInfo->code)) {
+          dupCount++;
+        }
+      } else {
+        if (index != newCount) {
+          // move forward（只移动 itemInfo，数据之后统一移动）
+          *getItem(newCount) = *pInfo;
+        }
+        newCount++;
+      }
+    }
+
+    // 留下的数据重新紧凑排列，回收 remove 留下的空洞（被删除的数据）。
+    // remove 把最后一项移到删除的位置，偏移不再随序号递增，因此按偏移从小到
+    // 大移动：目标位置只会向尾部移动，不会覆盖尚未移动的数据
+    std::sort(getItem(0), getItem(newCount),
+              [](const ItemInfo &a, const ItemInfo &b) {
+                return a.off < b.off;
+              });
+    uint32_t usedSpace = 0;
+    for (int index = 0; index < newCount; index++) {
+      ItemInfo *pInfo = getItem(index);
+      v.len = pInfo->len;
+      v.buf = getValuePtr(pInfo);
+      put(index, v, pInfo->code, usedSpace);
+    }
+    m_count = newCount;
+    m_usedSpace = usedSpace;
+    return dupCount;
+  }
+
+  void dump(const char *msg) const {
+    LOG_INFO("%s: Node_%p:(lock=%u,cap=%d,cnt=%d):", msg, this, m_lock,
+             m_capacity, m_count);
+    for (int i = 0; i < m_count; i++) {
+      LOG_INFO(" %x", getCode(i));
+    }
+    LOG_INFO("\n");
+  }
+
+  bool debug_verify(int hashIndex, int hashMask) const {
+    for (int i = 0; i < m_count; i++) {
+      if (!debug_verify(hashIndex, hashMask, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool debug_verify(int hashIndex, int hashMask, int item) const {
+    uint32_t hashCode = getCode(item);
+    int expectedIndex = hashCode & hashMask;
+    if (expectedIndex != hashIndex) {
+      char buf[256] = {0};
+      sprintf(buf, "inconsist hash value: %x: (%x & %x) != %x, diff=%x",
+              expectedIndex, hashCode, hashMask, hashIndex,
+              expectedIndex ^ hashIndex);
+      dump(buf);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  int32_t getAlignedSize(int size) const { return (size + 7) & 0x7ffffff8; }
+
+  int32_t calcNeedCapacity(int need) const {
+    int capacity = m_capacity ? m_capacity : 64;
+    while (capacity < need) {
+      capacity = capacity << 1;
+    }
+    return capacity;
+  }
+
+  void put(int index, const Slice &v, uint32_t hashCode, uint32_t &usedSpace) {
+    // call put before m_count is increased
+    ItemInfo *pInfo = getItem(index);
+    usedSpace += getAlignedSize(v.len);
+    pInfo->code = hashCode;
+    pInfo->len = v.len;
+    pInfo->off = usedSpace;
+    // split时，内存可能出现overlap
+    memmove(getValuePtr(pInfo), v.buf, v.len);
+  }
+
+  ItemInfo *getItem(int index) const { return (ItemInfo *)m_pBuffer + index; }
+
+  unsigned char *getValuePtr(ItemInfo *pItem) const {
+    return m_pBuffer + m_capacity - pItem->off;
+  }
+
+  int32_t getUsedSpace() const {
+    return sizeof(ItemInfo) * m_count + m_usedSpace;
+  }
+};
+
+template <class T, class Hasher = CalcHash> class SwissHashNode {
+  // 开放寻址的一组数据（参考 swiss table / F14）：
+  // 每项数据有一个字节的 tag（hashCode 的高 7 位 | 0x80），查找时使用 SIMD
+  // 一次比较整组的 tag。组内数据总是连续存放在 [0, m_count) 中，
+  // m_overflow 记录因本组已满而探测到后续组的数据个数，为 0 时查找可提前结束
+  using HashNode = SwissHashNode<T, Hasher>;
+
+private:
+  uint8_t m_tags[SWISS_GROUP_SIZE];
+  uint8_t m_count;
+  uint8_t m_overflow;
+  T m_values[SWISS_GROUP_SIZE];
+
+public:
+  static uint8_t getTag(uint32_t hashCode) {
+    return (uint8_t)(hashCode >> 24) | 0x80;
+  }
+
+  uint16_t getCount() const { return m_count; }
+
+  T getValue(int index) const { return m_values[index]; }
+
+  // 不保存 hashCode，需要时重新计算
+  uint32_t getCode(int index) const { return Hasher::get(m_values[index]); }
+
+  bool isFull() const { return m_count == SWISS_GROUP_SIZE; }
+
+  bool hasOverflow() const { return m_overflow != 0; }
+
+  void incOverflow() {
+    // 达到 255 后不再变化（查找时总是继续探测）
+    if (m_overflow != 0xff) {
+      m_overflow++;
+    }
+  }
+
+  void decOverflow() {
+    if (m_overflow != 0xff) {
+      m_overflow--;
+    }
+  }
+
+  int32_t find(const T &v, uint8_t tag) const {
+    // m_tags 之后紧跟 m_count、m_overflow，一次读取 16 字节
+    uint32_t m = CodeProbe::match16(m_tags, tag) & ((1u << m_count) - 1);
+    for (; m != 0; m &= m - 1) {
+      int k = __builtin_ctz(m);
+      if (m_values[k] == v) {
+        return k;
+      }
+    }
+    return -1;
+  }
+
+  void put(const T &v, uint8_t tag) {
+    m_tags[m_count] = tag;
+    m_values[m_count] = v;
+    m_count++;
+  }
+
+  void removeAt(int index) {
+    // 删除中间的，则需要把原先的最后一个，代替到当前位置
+    m_count--;
+    if (index < m_count) {
+      m_tags[index] = m_tags[m_count];
+      m_values[index] = m_values[m_count];
+    }
+  }
+
+  void dump(const char *msg) const {
+    LOG_INFO("%s: Group_%p:(cnt=%d,overflow=%d):", msg, this, m_count,
+             m_overflow);
+    for (int i = 0; i < m_count; i++) {
+      LOG_INFO(" %x", getCode(i));
+    }
+    LOG_INFO("\n");
+  }
+
+  bool debug_verify(int hashIndex, int hashMask) const {
+    for (int i = 0; i < m_count; i++) {
+      if (!debug_verify(hashIndex, hashMask, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool debug_verify(int hashIndex, int hashMask, int item) const {
+    // 开放寻址时数据不一定在其 hash 位置的组中，只检查 tag 是否一致
+    uint32_t hashCode = getCode(item);
+    if (getTag(hashCode) != m_tags[item]) {
+      char buf[256] = {0};
+      sprintf(buf, "inconsist tag: %x: %x != %x", hashCode, getTag(hashCode),
+              m_tags[item]);
+      dump(buf);
+      return false;
+    }
+    return true;
+  }
+};
+
+class CBloomFilter {
+  // 分块的 Bloom filter：每个 hashCode 的 BLOOM_PROBES 位都在同一个 64 字节
+  // 的块中，查询只访问一个 cache line。hashCode 的低位已用于选择分区及节点，
+  // 先经 MixHash::mix 重新混合
+  static const int BLOCK_BITS = 512;
+  static const int BLOCK_WORDS = BLOCK_BITS / 64;
+
+  uint64_t *m_bits{nullptr};
+  int64_t m_blocks{0};
+  bool m_owned{false};
+
+public:
+  CBloomFilter() {}
+  CBloomFilter(const CBloomFilter &) = delete;
+  CBloomFilter &operator=(const CBloomFilter &) = delete;
+
+  ~CBloomFilter() { release(); }
+
+  // 按预计的数据项数申请（已清零）
+  void init(int64_t expected) {
+    release();
+    int64_t bits = std::max<int64_t>(expected, 1) * BLOOM_BITS_PER_KEY;
+    m_blocks = (bits + BLOCK_BITS - 1) / BLOCK_BITS;
+    m_bits = new uint64_t[m_blocks * BLOCK_WORDS]();
+    m_owned = true;
+  }
+
+  // 使用外部的内存（如文件映射），不释放
+  void attach(const uint64_t *bits, int64_t blocks) {
+    release();
+    m_bits = (uint64_t *)bits;
+    m_blocks = blocks;
+  }
+
+  // atomic 为 true 时可与其他线程的 add 并发。只写入尚未设置的字
+  void add(uint32_t hashCode, bool atomic = false) {
+    uint64_t h = MixHash::mix(hashCode);
+    uint64_t *block = getBlock(h);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    uint64_t mask[BLOCK_WORDS] = {0};
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+      uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+      mask[bit >> 6] |= 1ULL << (bit & 63);
+    }
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+      if ((mask[i] & ~block[i]) == 0) {
+        continue;
+      }
+      if (atomic) {
+        __sync_fetch_and_or(&block[i], mask[i]);
+      } else {
+        block[i] |= mask[i];
+      }
+    }
+  }
+
+  bool mayContain(uint32_t hashCode) const {
+    uint64_t h = MixHash::mix(hashCode);
+    const uint64_t *block = getBlock(h);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    for (int i = 0; i < BLOOM_PROBES; i++) {
+      uint32_t bit = (h1 + i * h2) & (BLOCK_BITS - 1);
+      if ((block[bit >> 6] & (1ULL << (bit & 63))) == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const uint64_t *data() const { return m_bits; }
+
+  int64_t getBlockCount() const { return m_blocks; }
+
+  int64_t getBytes() const {
+    return m_blocks * BLOCK_WORDS * sizeof(uint64_t);
+  }
+
+private:
+  uint64_t *getBlock(uint64_t h) const {
+    // 块号取 h 的高 32 位按块数缩放，块数不必是 2 的幂
+    uint64_t index = ((h >> 32) * (uint64_t)m_blocks) >> 32;
+    return m_bits + index * BLOCK_WORDS;
+  }
+
+  void release() {
+    if (m_owned) {
+      delete[] m_bits;
+    }
+    m_bits = nullptr;
+    m_blocks = 0;
+    m_owned = false;
+  }
+};
+
+template <class T, class HashNode> class PartitionImpl {
+
+  using Partition = PartitionImpl<T, HashNode>;
+  using NodeAutoLock = CAutoLock<HashNode>;
+
+private:
+  // 多个线程访问，需要同步，避免编译器优化
+  // 扩容完成时，对hashMask及splitCursor的修改需要一次完成
+  // splitCursor 为下一个待领取分裂的节点，未扩容（或高区尚不可用）时为 -1。
+  // 各线程按 REHASH_STRIPE 个节点一段领取（CAS 整个 value），并行分裂
+  union EnlargeStatus {
+    uint64_t value;
+    struct {
+      int hashMask;
+      int splitCursor;
+    };
+  };
+  volatile EnlargeStatus m_status;
+  volatile int m_enlarging{0};
+  CStripedCounter m_count;
+  bool m_incremental{false};
+
+  // 本次扩容中已经分裂的节点（每个低区节点一位）及个数，分裂的顺序不确定。
+  // 第一个字为扩容前的容量，用于识别上一轮扩容的位图。
+  // 扩容完成后 m_splitBits 置空，旧的位图（其他线程可能仍在读）保留到下一轮
+  // 扩容完成：读位图的线程持有某个节点的锁，下一轮扩容会逐个锁住这些节点
+  uint64_t *volatile m_splitBits{nullptr};
+  volatile int m_splitCount{0};
+  uint64_t *m_retiredSplitBits{nullptr};
+
+  int m_tableSize{0};
+  int m_usedTableEntries{0};
+  int m_mappedEntries{0}; // m_table 的前几项为快照映射的内存，不释放
+  HashNode **m_table{nullptr};
+  CBufferManager *m_bufMgr{nullptr};
+  bool m_cocurrent{false};
+  int m_nextEnlargingSize{0};
+  int m_partIndex{0};
+
+  int m_initCapacityBits{0};
+  int m_nodeCountPerChunk{0};
+
+  // 节点表按块申请（每次扩容的高区为一块，可以使用大页），m_table 中的
+  // 各项指向块内。记录块的地址及包含的 m_table 项数，用于释放
+  AllocPolicy m_policy;
+  std::vector<std::pair<HashNode *, int>> m_nodeBlocks;
+  // m_nodeBlocks 实际占用的内存（按分配策略取整），memoryUsage 并发读取
+  volatile size_t m_nodeBlockBytes{0};
+
+  // 可选的 Bloom filter（见 setPrefilter），find 前先检查，不存在的数据大多
+  // 不需要访问节点。扩容时按新的容量创建 m_pendingFilter，分裂节点时写入，
+  // 扩容结束时替换。线程安全版本中替换下的 filter 记录当时的 epoch，其他线程
+  // 不再读取后释放（见 retireFilter）
+  bool m_prefilter{false};
+  CBloomFilter *volatile m_filter{nullptr};
+  CBloomFilter *volatile m_pendingFilter{nullptr};
+  std::vector<std::pair<CBloomFilter *, uint64_t>> m_retiredFilters;
+  volatile int64_t m_filterBytes{0};
+  volatile int m_removedSinceBuild{0};
+
+  SpinnedLock m_rwmutex;
+
+#ifdef DEBUG_VERIFY_AFTER_ENLARGE
+  volatile bool m_blocking{false};
+#endif
+
+public:
+  PartitionImpl(bool cocurrent, int partIndex, int initCapacityBits,
+                const AllocPolicy &policy = AllocPolicy())
+      : m_cocurrent(cocurrent), m_partIndex(partIndex),
+        m_initCapacityBits(initCapacityBits), m_policy(policy) {
+
+    m_rwmutex.setName(partIndex);
+    m_nodeCountPerChunk = 1 << initCapacityBits;
+
+    m_tableSize = (1 << (MAX_CAPACITY_BITS - initCapacityBits + 1));
+    m_table = new HashNode *[m_tableSize];
+    m_bufMgr =
+        new CBufferManager(cocurrent, DEF_ARENA_COUNT, policy, partIndex);
+
+    allocNodeChunk(1);
+    m_status.hashMask = (1 << m_initCapacityBits) - 1;
+    m_status.splitCursor = -1;
+    m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+  }
+
+  ~PartitionImpl() {
+    _clear(false);
+    delete[] m_table;
+    delete m_bufMgr;
+  }
+
+  void clear() { _clear(true); }
+
+  HashNode *getNode(int index) const {
+    // assert((index >> m_initCapacityBits) < this->m_usedTableEntries);
+    return m_table[index >> m_initCapacityBits] +
+           (index & (m_nodeCountPerChunk - 1));
+  }
+
+  // 可遍历的最大节点号。扩容中（高区已可用）为扩容后的 mask，
+  // 未分裂的节点中的数据仍在低区，高区对应节点为空
+  int getMask() const {
+    EnlargeStatus s;
+    s.value = m_status.value;
+    return visibleMask(s);
+  }
+
+  // mask 与 splitCursor 需要一次读取（扩容结束时二者同时更新）。
+  // 该值不变期间，数据最多从低区节点移到对应的高区节点
+  static int visibleMask(const EnlargeStatus &s) {
+    return s.splitCursor >= 0 ? (s.hashMask << 1) | 1 : s.hashMask;
+  }
+
+  void prefetch(uint32_t hashCode) const {
+    // 线程安全版本不加锁，不读分裂位图（可能已经释放），只按 mask 预取
+    int index = m_cocurrent ? hashCode & m_status.hashMask
+                            : getNodeIndex(hashCode);
+    __builtin_prefetch(getNode(index));
+  }
+
+  int64_t size() const { return m_count.sum(); }
+
+  // 渐进扩容：扩容时只申请高区，之后每次 add 分裂 REHASH_STEP 个节点，
+  // 不再由触发扩容的线程一次完成全部分裂。只对之后开始的扩容生效
+  void setIncrementalRehash(bool incremental) { m_incremental = incremental; }
+
+  void finishRehash() {
+    // 完成未结束的渐进扩容。本函数不支持并发
+    while (rehashStep(REHASH_STRIPE)) {
+    }
+  }
+
+  // 开启时按现有数据建立 Bloom filter。本函数不支持并发
+  void setPrefilter(bool prefilter) {
+    finishRehash();
+    m_prefilter = prefilter;
+    if (prefilter) {
+      rebuildFilter();
+    } else {
+      CBloomFilter *old = m_filter;
+      m_filter = nullptr;
+      retireFilter(old);
+    }
+  }
+
+  bool add(const T &v, uint32_t hashCode) {
+    bool ret;
+    if (!m_cocurrent) {
+      HashNode *node = this->getNode(getNodeIndex(hashCode));
+      ret = node->safeAdd(m_bufMgr, v, hashCode);
+      if (ret) {
+        if (m_prefilter) {
+          addToFilter(hashCode);
+        }
+        m_count.add(1, false);
+        tryEnlargeHashTable();
+      }
+    } else {
+      ret = cocurrentAdd(v, hashCode);
+    }
+
+    if (m_enlarging == 2) {
+      // 扩容中，帮助分裂：渐进扩容时只分裂少量节点，否则与触发扩容的线程
+      // 一起领取分裂，直到没有未领取的节点
+      if (m_incremental) {
+        rehashStep(REHASH_STEP);
+      } else {
+        while (rehashStep(REHASH_STRIPE)) {
+        }
+      }
+    }
+    return ret;
+  }
+
+#ifdef DEBUG_VERIFY_AFTER_ENLARGE
+  bool waitForUnblock() {
+    while (m_blocking) {
+      usleep(100);
+    }
+    return true;
+  }
+#endif
+
+  bool cocurrentAdd(const T &v, uint32_t hashCode) {
+    HashNode *node = lockNode(hashCode);
+    bool ret = node->safeAdd(m_bufMgr, v, hashCode);
+    if (ret) {
+      // 在节点锁内写入 filter：分裂本节点时（写入新的 filter）不会遗漏
+      if (m_prefilter) {
+        addToFilter(hashCode);
+      }
+      m_count.add(1, true);
+    }
+    node->unlock();
+
+    if (ret) {
+      tryEnlargeHashTable();
+    }
+
+    return ret;
+  }
+
+  HashNode *lockNode(uint32_t hashCode) {
+    // 返回 hashCode 所在的节点（已加锁）
+    // 利用分裂位图（m_splitBits），来避免上锁（m_rwmutex）
+    // 未扩区时，m_splitBits 为空。（此时高区不可用，或无任何顶点已经分裂）
+    // 扩区过程中各节点分裂时（持有节点锁）设置对应的位。（高区可用）
+    // 扩区结束时，先更新 hashMask，再清空 m_splitBits（下一轮扩区结束时释放）
+    // 取到node锁后，当前节点的分裂状态不会改变。节点尚未分裂时扩区也不会结束，
+    // 已经分裂时扩区可能随时结束
+    //    可以保证：当前需要操作的node要不然完成分裂，要不尚未开始分裂
+
+#ifdef DEBUG_VERIFY_AFTER_ENLARGE
+    waitForUnblock();
+#endif
+
+    uint32_t hashMask = m_status.hashMask;
+    int hashIndex = hashCode & hashMask;
+    HashNode *node = this->getNode(hashIndex);
+    node->lock();
+    for (;;) {
+      // 在加锁过程中，可能已经完成多轮扩区
+      while (hashMask != m_status.hashMask) {
+        node->unlock();
+        hashMask = m_status.hashMask;
+        hashIndex = hashCode & hashMask;
+        node = this->getNode(hashIndex);
+        node->lock();
+      }
+
+      if ((hashCode & (hashMask + 1)) == 0) {
+        return node;
+      }
+      // 扩区中，新的值属于分裂后的新节点，可能需加入到分裂后的新节点
+      // 先取位图再取 mask：mask 未变时，位图为空、属于上一轮扩区（本轮尚未
+      // 开始分裂）或属于本次扩区
+      uint64_t *bits = m_splitBits;
+      if (hashMask == m_status.hashMask &&
+          !isSplit(bits, hashMask + 1, hashIndex)) {
+        return node;
+      }
+      // 扩区进行中且当前节点已经分裂，或者自从获取 hashMask 后扩区刚完成
+      hashIndex = hashIndex + hashMask + 1;
+      HashNode *node2 = this->getNode(hashIndex);
+      node2->lock();
+      node->unlock();
+      node = node2;
+      if (hashMask == m_status.hashMask) {
+        // 扩区仍在进行，高区节点在扩区结束前不会分裂
+        return node;
+      }
+      // 高区节点属于新的 mask，下一轮扩区可能已经分裂了该节点，继续检查
+      hashMask = hashMask * 2 + 1;
+    }
+  }
+
+  int find(const T &v, uint32_t hashCode, int &hashIndex) const {
+    if (!m_cocurrent) {
+      if (!mayContain(hashCode)) {
+        hashIndex = hashCode & m_status.hashMask;
+        return -1;
+      }
+      hashIndex = getNodeIndex(hashCode);
+      return getNode(hashIndex)->find(v, hashCode);
+    }
+
+    // 不加锁读取：读取期间节点释放的扩展内存及替换下的 filter 不会被释放，
+    // 节点按版本号校验（seqlock），读取期间有写入时重读该节点
+    CEpoch::Guard guard;
+    if (!mayContain(hashCode)) {
+      hashIndex = hashCode & m_status.hashMask;
+      return -1;
+    }
+    for (;;) {
+      // mask 与 splitCursor 一次读取：不能用 m_enlarging 判断高区是否可用，
+      // 扩容结束时它与新的 mask 不是同时更新的
+      EnlargeStatus s;
+      s.value = m_status.value;
+      int hashMask = s.hashMask;
+      hashIndex = hashCode & hashMask;
+      int32_t itemIndex = readNode(hashIndex, v, hashCode);
+      if (itemIndex >= 0) {
+        return itemIndex;
+      }
+      // 目标分区可能正在扩区。（内存已经ready）。
+      // 低区节点已经分裂时数据可能在高区，只要高区可用就需要搜索高区
+      if (s.splitCursor >= 0 && (hashCode & (hashMask + 1))) {
+        int highIndex = hashIndex + hashMask + 1;
+        itemIndex = readNode(highIndex, v, hashCode);
+        if (itemIndex >= 0) {
+          hashIndex = highIndex;
+          return itemIndex;
+        }
+      }
+      // 查找期间高区变为可用或者扩区已经结束（数据可能又移到了其他节点），
+      // 按新的状态重试
+      EnlargeStatus now;
+      now.value = m_status.value;
+      if (visibleMask(now) == visibleMask(s)) {
+        return -1;
+      }
+    }
+  }
+
+  bool mayContain(uint32_t hashCode) const {
+    CBloomFilter *filter = m_filter;
+    return filter == nullptr || filter->mayContain(hashCode);
+  }
+
+  int32_t readNode(int index, const T &v, uint32_t hashCode) const {
+    // 不加锁读取一个节点，读取期间有写入时重试
+    HashNode *node = getNode(index);
+    for (;;) {
+      uint32_t version = node->readBegin();
+      int32_t itemIndex = node->find(v, hashCode);
+      if (!node->readRetry(version)) {
+        return itemIndex;
+      }
+    }
+  }
+
+  void reserve(int64_t count) {
+    // 预先扩容到 count 项不超过扩容阈值，之后的加入不再逐次翻倍。
+    // 不支持并发；未完成的渐进扩容先全部分裂
+    finishRehash();
+    int capacity = m_status.hashMask + 1;
+    while (capacity < (1 << MAX_CAPACITY_BITS) &&
+           HASH_RATIO * capacity < count) {
+      capacity *= 2;
+    }
+    if (capacity == m_status.hashMask + 1) {
+      return;
+    }
+    if (m_count.sum() == 0) {
+      // 空分区：按翻倍的顺序申请节点块，直接设置 mask，无需分裂
+      while (m_usedTableEntries * m_nodeCountPerChunk < capacity) {
+        allocNodeChunk(m_usedTableEntries);
+      }
+      EnlargeStatus s;
+      s.hashMask = capacity - 1;
+      s.splitCursor = -1;
+      m_status.value = s.value;
+      m_nextEnlargingSize = HASH_RATIO * capacity;
+      if (m_prefilter) {
+        rebuildFilter();
+      }
+      return;
+    }
+    while (m_status.hashMask + 1 < capacity) {
+      m_enlarging = 1;
+      enlargeHashTable(m_status.hashMask + 1);
+      finishRehash();
+    }
+  }
+
+  // 收缩：数据较少时按扩容的相反顺序把节点表减半（高区节点并入低区，释放
+  // 最后一个节点块），再把各节点的扩展内存紧凑地复制到新的 CBufferManager，
+  // 释放原来的全部数据块。返回释放的字节数。
+  // 不支持并发（不加锁的读者可能仍在读取释放的内存）；快照映射的分区不收缩
+  size_t compact() {
+    if (m_mappedEntries > 0) {
+      return 0;
+    }
+    finishRehash();
+    MemoryUsage before;
+    getMemoryUsage(before);
+
+    // 收缩后的个数不超过扩容阈值的一半，之后的 add 不会马上再次扩容
+    int64_t count = m_count.sum();
+    int capacity = m_status.hashMask + 1;
+    while (capacity > m_nodeCountPerChunk &&
+           count * 2 <= HASH_RATIO * (capacity / 2) &&
+           shrinkHashTable(capacity)) {
+      capacity /= 2;
+    }
+
+    CBufferManager *bufMgr =
+        new CBufferManager(m_cocurrent, DEF_ARENA_COUNT, m_policy, m_partIndex);
+    for (int i = 0; i < capacity; i++) {
+      getNode(i)->repack(bufMgr);
+    }
+    delete m_bufMgr;
+    m_bufMgr = bufMgr;
+
+    delete[] m_retiredSplitBits;
+    m_retiredSplitBits = nullptr;
+    if (m_prefilter) {
+      rebuildFilter();
+    }
+    releaseRetiredFilters();
+
+    MemoryUsage after;
+    getMemoryUsage(after);
+    return before.total() > after.total() ? before.total() - after.total() : 0;
+  }
+
+  int addAll(Partition *pSrc) {
+    // 本函数不支持并发，this和 pSrc均不存在其他线程的修改
+    // 把src的全部内容加入到当前分区中。返回成功加入的个数
+    // 两者的 hashMask可能不同，因此需要逐个处理
+    // 合并后的个数在两者中较大者与两者之和之间，按较大者扩容，
+    // 数据重复较多时不会过度扩容
+    reserve(std::max(size(), pSrc->size()));
+    int n = 0;
+    int srcMask = pSrc->getMask();
+    for (int srcIndex = 0; srcIndex <= srcMask; srcIndex++) {
+      HashNode *srcNode = pSrc->getNode(srcIndex);
+      for (int i = 0; i < srcNode->getCount(); i++) {
+        if (this->add(srcNode->getValue(i), srcNode->getCode(i))) {
+          n++;
+        }
+      }
+    }
+    return n;
+  }
+
+  bool remove(const T &v, uint32_t hashCode) {
+    // 线程安全版本中可与 add、remove、find 及扩容并发：与 cocurrentAdd 相同，
+    // 由 lockNode 按分裂位图定位（mask 变化时重试），取得节点锁后数据所在的
+    // 节点不会再变化。渐进扩容未完成时也能正确删除。
+    // remove 不迁移节点，erase 时迭代器不会因此失效
+    HashNode *node;
+    if (m_cocurrent) {
+      node = lockNode(hashCode);
+    } else {
+      node = this->getNode(getNodeIndex(hashCode));
+    }
+    bool ret = node->remove(v, hashCode);
+    if (m_cocurrent) {
+      node->unlock();
+    }
+
+    if (ret) {
+      m_count.add(-1, m_cocurrent);
+      // Bloom filter 不能删除，删除较多时重建（扩容中则由扩容结束时替换）
+      if (m_filter != nullptr &&
+          __sync_add_and_fetch(&m_removedSinceBuild, 1) >
+              m_count.approx() / 4 + 1024 &&
+          m_enlarging == 0) {
+        if (m_cocurrent) {
+          cocurrentRebuildFilter();
+        } else {
+          rebuildFilter();
+        }
+      }
+    }
+    return ret;
+  }
+
+  bool save(CSnapshotFile &file, SnapshotPartition &part) const {
+    // 写入节点表及数据块，节点中的数据块指针转换为文件中的偏移
+    // 本函数不支持并发，不存在其他线程的修改
+    int64_t count = m_count.sum();
+    if (count > INT32_MAX) {
+      // 快照中每个分区的个数为 int32
+      LOG_ERROR("too many values to save in a partition: %ld\n",
+                (long)count);
+      return false;
+    }
+    std::vector<unsigned char *> chunks;
+    m_bufMgr->getChunks(chunks);
+    std::vector<std::pair<unsigned char *, int64_t>> sorted;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      sorted.push_back(std::make_pair(chunks[i], (int64_t)i));
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    part.hashMask = m_status.hashMask;
+    part.count = (int32_t)count;
+    part.nodeCount = (int64_t)m_usedTableEntries * m_nodeCountPerChunk;
+    part.nodeOffset = file.align();
+    if (part.nodeOffset < 0) {
+      return false;
+    }
+    HashNode *nodes = new HashNode[m_nodeCountPerChunk];
+    bool ok = true;
+    for (int i = 0; ok && i < m_usedTableEntries; i++) {
+      memcpy(nodes, m_table[i], sizeof(HashNode) * m_nodeCountPerChunk);
+      for (int k = 0; k < m_nodeCountPerChunk; k++) {
+        unsigned char *buf = nodes[k].getBuffer();
+        if (buf != nullptr) {
+          int64_t offset = toSnapshotOffset(sorted, buf) + 1;
+          nodes[k].setBuffer((unsigned char *)(uintptr_t)offset);
+        }
+      }
+      ok = file.write(nodes, sizeof(HashNode) * m_nodeCountPerChunk);
+    }
+    delete[] nodes;
+
+    part.chunkCount = chunks.size();
+    part.chunkOffset = file.align();
+    ok = ok && part.chunkOffset >= 0;
+    for (size_t i = 0; ok && i < chunks.size(); i++) {
+      ok = file.write(chunks[i], DATA_CHUNK_SIZE);
+    }
+    return ok;
+  }
+
+  bool load(CSnapshotFile &file, const SnapshotPartition &part) {
+    // 从快照加载，映射模式下直接使用文件映射的内存（只修正数据块指针，
+    // 不重新计算 hash）。本函数不支持并发，失败时需要调用 clear。
+    // 映射是私有的：数据块只读，与页缓存共享、按需读入；节点表中有扩展内存
+    // 的节点需要改写指针，所在的页会被复制为进程私有的内存。因此映射只省去
+    // 数据块的读取及内存，节点表与读取方式的开销相当
+    int entries = part.nodeCount / m_nodeCountPerChunk;
+    if (part.nodeCount != (int64_t)part.hashMask + 1 ||
+        part.nodeCount % m_nodeCountPerChunk != 0 || entries >= m_tableSize) {
+      return false;
+    }
+    _clear(false);
+
+    std::vector<unsigned char *> chunks;
+    for (int64_t i = 0; i < part.chunkCount; i++) {
+      int64_t offset = part.chunkOffset + i * DATA_CHUNK_SIZE;
+      if (file.isMapped()) {
+        unsigned char *p = file.at(offset, DATA_CHUNK_SIZE);
+        if (p == nullptr) {
+          return false;
+        }
+        chunks.push_back(m_bufMgr->addChunk(p));
+      } else {
+        chunks.push_back(m_bufMgr->addChunk(nullptr));
+        if (!file.read(offset, chunks.back(), DATA_CHUNK_SIZE)) {
+          return false;
+        }
+      }
+    }
+
+    int64_t bytes = sizeof(HashNode) * m_nodeCountPerChunk;
+    if (file.isMapped()) {
+      for (int i = 0; i < entries; i++) {
+        unsigned char *p = file.at(part.nodeOffset + i * bytes, bytes);
+        if (p == nullptr) {
+          return false;
+        }
+        m_table[i] = (HashNode *)p;
+        m_usedTableEntries++;
+        m_mappedEntries++;
+      }
+    } else {
+      allocNodeChunk(entries);
+      for (int i = 0; i < entries; i++) {
+        if (!file.read(part.nodeOffset + i * bytes, m_table[i], bytes)) {
+          return false;
+        }
+      }
+    }
+
+    for (int64_t i = 0; i < part.nodeCount; i++) {
+      HashNode *node = getNode(i);
+      unsigned char *buf = node->getBuffer();
+      if (buf != nullptr) {
+        int64_t offset = (int64_t)(uintptr_t)buf - 1;
+        if (offset < 0 || offset / DATA_CHUNK_SIZE >= part.chunkCount) {
+          return false;
+        }
+        node->setBuffer(chunks[offset / DATA_CHUNK_SIZE] +
+                        offset % DATA_CHUNK_SIZE);
+      }
+    }
+
+    EnlargeStatus s;
+    s.hashMask = part.hashMask;
+    s.splitCursor = -1;
+    m_status.value = s.value;
+    m_enlarging = 0;
+    m_count.reset(part.count);
+    m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+    return true;
+  }
+
+  // 统计内存占用，加到 usage 中（快照映射的部分由 FastHashSet 统计）。
+  // 可与 add 并发
+  void getMemoryUsage(MemoryUsage &usage) const {
+    usage.nodeTable += m_nodeBlockBytes;
+    // m_table 按最大容量申请，只计算用到的项（其余的不会占用物理内存）；
+    // 分裂位图为每个低区节点一位，保留上一轮及进行中的一轮
+    int capacity = m_status.hashMask + 1;
+    size_t splitBits = capacity > (1 << m_initCapacityBits) ? capacity / 16 : 0;
+    if (m_enlarging == 2) {
+      splitBits += capacity / 8;
+    }
+    usage.overhead += sizeof(*this) + sizeof(HashNode *) * m_usedTableEntries +
+                      splitBits + m_filterBytes;
+    m_bufMgr->getMemoryUsage(usage);
+  }
+
+  int debug_verify(int partIndex) const {
+    int nErrCount = 10;
+    int count = m_usedTableEntries * m_nodeCountPerChunk;
+    int total = 0;
+    int hashMask = this->m_status.hashMask;
+    int mid = (hashMask + 1) >> 1;
+    for (int i = 0; i < count; i++) {
+      auto node = getNode(i);
+      total += node->getCount();
+      // 渐进扩容未完成时，高区的节点按扩容后的 mask 检查
+      int mask = i > hashMask ? (hashMask << 1) | 1 : hashMask;
+      if (!node->debug_verify(i, mask)) {
+        if (i < mid) {
+          auto node2 = getNode(i + mid);
+          char buf[256];
+          sprintf(buf, "high-part(%x)", i + mid);
+          node2->dump(buf);
+        }
+        if (--nErrCount == 0) {
+          break;
+        }
+      }
+    }
+    return total;
+  }
+
+  void dump_stat(const char *msg) const {
+    struct {
+      int hist[4];   // for count is zero and one
+      int max_len;   // max len of node
+      int max_index; // node index with max len
+      long total;    // total len of node
+      long square;
+    } m{0};
+
+    int count = m_usedTableEntries * m_nodeCountPerChunk;
+    for (int i = 0; i < count; i++) {
+      auto node = getNode(i);
+      int c = node->getCount();
+      m.total += c;
+      m.square += c * c;
+
+      if (c > m.max_len) {
+        m.max_len = c;
+        m.max_index = i;
+      }
+      if (c < 4)
+        m.hist[c]++;
+    }
+
+    float avg = (float)m.total / count;
+    float std = sqrt((float)m.square / count - avg * avg);
+    LOG_INFO("%s nodes=%d max=%d(%d) avg=%.3f std=%.3f hist=[%d", msg, count,
+             m.max_len, m.max_index, avg, std, m.hist[0]);
+    for (int i = 1; i < 4; i++) {
+      LOG_INFO(",%d", m.hist[i]);
+    }
+
+    this->m_bufMgr->dump_stat("]");
+  }
+
+private:
+  void _clear(bool withInit) {
+    m_bufMgr->clear();
+    int toKeep = 0;
+
+    if (withInit) {
+      if (m_mappedEntries == 0 && !m_nodeBlocks.empty() &&
+          m_nodeBlocks[0].second == 1) {
+        // 重用1块内存，降低内存申请释放开销，及缺页中断机会
+        toKeep = 1;
+        memset(m_table[0], 0, sizeof(HashNode) * m_nodeCountPerChunk);
+      }
+      EnlargeStatus s;
+      s.hashMask = (1 << m_initCapacityBits) - 1;
+      s.splitCursor = -1;
+      m_status.value = s.value;
+      m_enlarging = 0;
+      m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+    }
+
+    size_t chunkBytes = sizeof(HashNode) * m_nodeCountPerChunk;
+    for (size_t i = toKeep; i < m_nodeBlocks.size(); i++) {
+      CPageAllocator::release(m_nodeBlocks[i].first,
+                              chunkBytes * m_nodeBlocks[i].second, m_policy);
+    }
+    m_nodeBlocks.resize(toKeep);
+    m_nodeBlockBytes =
+        toKeep == 0 ? 0 : CPageAllocator::getAllocSize(chunkBytes, m_policy);
+    m_usedTableEntries = toKeep;
+    m_mappedEntries = 0;
+    m_count.reset(0);
+
+    delete[] m_splitBits;
+    m_splitBits = nullptr;
+    delete[] m_retiredSplitBits;
+    m_retiredSplitBits = nullptr;
+
+    releaseFilter(m_filter);
+    releaseFilter(m_pendingFilter);
+    m_filter = m_pendingFilter = nullptr;
+    releaseRetiredFilters();
+    m_filterBytes = 0;
+
+    if (withInit && toKeep == 0) {
+      allocNodeChunk(1);
+    }
+    if (withInit && m_prefilter) {
+      m_filter = newFilter(m_nextEnlargingSize);
+    }
+  }
+
+  static int64_t toSnapshotOffset(
+      const std::vector<std::pair<unsigned char *, int64_t>> &chunks,
+      unsigned char *buf) {
+    // chunks 按地址排序，查找 buf 所在的数据块
+    auto it = std::upper_bound(
+        chunks.begin(), chunks.end(),
+        std::make_pair(buf, (int64_t)INT64_MAX));
+    --it;
+    return it->second * DATA_CHUNK_SIZE + (buf - it->first);
+  }
+
+  void allocNodeChunk(int count = 1) {
+    // 除第一个外，之后每个都必须翻倍
+    assert(m_usedTableEntries == 0 || m_usedTableEntries == count);
+    assert(m_usedTableEntries + count < this->m_tableSize);
+    // 申请的内存已清零（默认策略为 calloc，其他为 mmap），大块内存由系统
+    // 按页延迟清零
+    HashNode *nodes = (HashNode *)CPageAllocator::alloc(
+        sizeof(HashNode) * m_nodeCountPerChunk * count, m_policy, m_partIndex);
+    if (nodes == nullptr) {
+      throw std::bad_alloc();
+    }
+    m_nodeBlocks.push_back(std::make_pair(nodes, count));
+    m_nodeBlockBytes += CPageAllocator::getAllocSize(
+        sizeof(HashNode) * m_nodeCountPerChunk * count, m_policy);
+    for (int i = 0; i < count; i++) {
+      m_table[m_usedTableEntries] = nodes + (size_t)i * m_nodeCountPerChunk;
+      m_usedTableEntries++;
+    }
+  }
+
+  bool needEnlargeHashTable() const {
+    if (m_enlarging)
+      return false;
+
+    // 线程安全版本中先按近似值判断，接近阈值时才求和（读取各行计数）
+    int64_t count = m_count.approx();
+    if (m_cocurrent && count + CStripedCounter::MAX_ERROR > m_nextEnlargingSize)
+      count = m_count.sum();
+    return count > m_nextEnlargingSize;
+  }
+
+  void tryEnlargeHashTable() {
+    // 检查扩容需要加锁，先检查一次
+    if (!needEnlargeHashTable())
+      return;
+
+    if (m_cocurrent) {
+      m_rwmutex.lock();
+    }
+
+    // 加锁后，重复检查
+    if (needEnlargeHashTable()) {
+      // 拒绝其他线程进入
+      m_enlarging = 1;
+      assert(m_status.splitCursor == -1);
+      int capacity = m_status.hashMask + 1;
+
+      if (m_cocurrent) {
+        m_rwmutex.unlock();
+      }
+
+      // 耗时操作开始（已经解锁）
+      this->enlargeHashTable(capacity);
+    } else if (m_cocurrent) {
+      m_rwmutex.unlock();
+    }
+  }
+
+  bool shrinkHashTable(int capacity) {
+    // 扩容的逆操作：高区节点的数据并入低区，释放高区所在的节点块。
+    // 只有最后一块恰好为高区时才能释放（快照加载时节点表为一整块）
+    int half = capacity / 2;
+    if (m_usedTableEntries * m_nodeCountPerChunk != capacity ||
+        m_nodeBlocks.back().second * m_nodeCountPerChunk != half) {
+      return false;
+    }
+    for (int i = 0; i < half; i++) {
+      HashNode *node = getNode(i);
+      HashNode *high = getNode(i + half);
+      for (int k = 0; k < high->getCount(); k++) {
+        node->safeAdd(m_bufMgr, high->getValue(k), high->getCode(k));
+      }
+    }
+    size_t chunkBytes = sizeof(HashNode) * m_nodeCountPerChunk;
+    CPageAllocator::release(m_nodeBlocks.back().first,
+                            chunkBytes * m_nodeBlocks.back().second, m_policy);
+    m_nodeBlockBytes -= CPageAllocator::getAllocSize(
+        chunkBytes * m_nodeBlocks.back().second, m_policy);
+    m_usedTableEntries -= m_nodeBlocks.back().second;
+    m_nodeBlocks.pop_back();
+
+    EnlargeStatus s;
+    s.hashMask = half - 1;
+    s.splitCursor = -1;
+    m_status.value = s.value;
+    m_nextEnlargingSize = HASH_RATIO * half;
+    return true;
+  }
+
+  void enlargeHashTable(int capacity) {
+    // 扩展hashTable，按当前容量翻倍
+    if (m_prefilter) {
+      // 之后的 add 同时写入新旧 filter，已有的数据在分裂时写入
+      m_pendingFilter = newFilter(HASH_RATIO * capacity * 2);
+    }
+    allocNodeChunk(capacity / m_nodeCountPerChunk);
+    uint64_t *bits = new uint64_t[1 + (capacity + 63) / 64]();
+    bits[0] = capacity;
+    m_splitBits = bits;
+    m_splitCount = 0;
+
+    // 进入第二阶段，高区表已经可用，开始领取分裂
+    this->m_enlarging = 2;
+    m_status.splitCursor = 0;
+
+    if (!m_incremental) {
+      // 其他线程的 add 看到 m_enlarging 为 2 时也会领取分裂。
+      // 最后完成分裂的线程结束扩容
+      while (rehashStep(REHASH_STRIPE)) {
+      }
+    }
+    // 渐进扩容：分裂由之后的 add 逐步完成
+  }
+
+  bool rehashStep(int steps) {
+    // 领取之后的 steps 个节点并分裂，没有可领取的节点时返回 false
+    EnlargeStatus s, next;
+    do {
+      s.value = m_status.value;
+      if (s.splitCursor < 0 || s.splitCursor > s.hashMask) {
+        return false;
+      }
+      next.hashMask = s.hashMask;
+      next.splitCursor = std::min(s.splitCursor + steps, s.hashMask + 1);
+    } while (!Atomic::CAS(&m_status.value, s.value, next.value));
+
+    int capacity = s.hashMask + 1;
+    for (int i = s.splitCursor; i < next.splitCursor; i++) {
+      splitNode(i, capacity);
+    }
+    int n = next.splitCursor - s.splitCursor;
+    if (__sync_add_and_fetch(&m_splitCount, n) == capacity) {
+      finishEnlarge(capacity);
+    }
+    return true;
+  }
+
+  void finishEnlarge(int capacity) {
+    if (m_cocurrent) {
+      m_rwmutex.lock();
+    }
+
+    if (m_pendingFilter != nullptr) {
+      // 全部节点已经分裂，新的 filter 包含所有数据
+      CBloomFilter *old = m_filter;
+      m_filter = m_pendingFilter;
+      m_pendingFilter = nullptr;
+      m_removedSinceBuild = 0;
+      retireFilter(old);
+    }
+
+    EnlargeStatus s;
+    s.splitCursor = -1;
+    s.hashMask = capacity + m_status.hashMask;
+    // 使用原子操作
+    m_status.value = s.value;
+#ifdef DEBUG_DELAY_FINISH_ENLARGE
+    usleep(DEBUG_DELAY_FINISH_ENLARGE);
+#endif
+    // 新的 mask 发布后才能清除扩容状态：先清除时，读线程可能取到旧的 mask
+    // 而不再查找高区，漏掉已经分裂到高区的数据
+    m_enlarging = 0;
+
+    // 更新 mask 后才能清空：否则 lockNode 可能取到空的位图及旧的 mask，
+    // 把数据加入已经分裂的低区节点。
+    // 上一轮的位图只可能被持有其低区节点（本轮的全部低区节点）锁的线程读取，
+    // 本轮已经逐个锁住并分裂了这些节点，不再有线程引用，可以释放
+    delete[] m_retiredSplitBits;
+    m_retiredSplitBits = (uint64_t *)m_splitBits;
+    m_splitBits = nullptr;
+
+    if (m_status.hashMask < ((1 << MAX_CAPACITY_BITS) - 1))
+      m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+
+    if (m_cocurrent) {
+      m_rwmutex.unlock();
+    }
+
+#ifdef DEBUG_VERIFY_AFTER_ENLARGE
+    m_blocking = true;
+    this->debug_verify(m_partIndex);
+    m_blocking = false;
+#endif
+  }
+
+  void splitNode(int index, int capacity) {
+    HashNode *node1 = getNode(index);
+    HashNode *node2 = getNode(capacity + index);
+
+    node1->lock();
+    node2->lock();
+
+    node1->split(this->m_bufMgr, node2, capacity);
+    __sync_fetch_and_or(&m_splitBits[1 + (index >> 6)], 1ULL << (index & 63));
+    CBloomFilter *filter = m_pendingFilter;
+    if (filter != nullptr) {
+      addNodeToFilter(filter, node1);
+      addNodeToFilter(filter, node2);
+    }
+
+    node2->unlock();
+    node1->unlock();
+  }
+
+  CBloomFilter *newFilter(int64_t expected) {
+    CBloomFilter *filter = new CBloomFilter();
+    filter->init(expected);
+    __sync_fetch_and_add(&m_filterBytes, filter->getBytes());
+    return filter;
+  }
+
+  void retireFilter(CBloomFilter *filter) {
+    // 释放已经替换下的 filter。在 finishEnlarge、cocurrentRebuildFilter（已
+    // 持有 m_rwmutex）或无并发时调用。
+    // 线程安全版本中，不加锁的 find 在 CEpoch::Guard 内读取 filter，替换后
+    // 记录当时的 epoch，之后的替换中 epoch 安全时释放；在节点锁内写入 filter
+    // 的 add 在下一次替换前已经结束（替换前逐个锁住了全部节点）
+    if (filter == nullptr) {
+      return;
+    }
+    if (!m_cocurrent) {
+      releaseFilter(filter);
+      return;
+    }
+    uint64_t epoch = CEpoch::tryAdvance();
+    size_t kept = 0;
+    for (size_t i = 0; i < m_retiredFilters.size(); i++) {
+      if (CEpoch::isSafe(m_retiredFilters[i].second, epoch)) {
+        releaseFilter(m_retiredFilters[i].first);
+      } else {
+        m_retiredFilters[kept++] = m_retiredFilters[i];
+      }
+    }
+    m_retiredFilters.resize(kept);
+    m_retiredFilters.push_back(std::make_pair(filter, CEpoch::current()));
+  }
+
+  void releaseFilter(CBloomFilter *filter) {
+    if (filter != nullptr) {
+      __sync_fetch_and_sub(&m_filterBytes, filter->getBytes());
+      delete filter;
+    }
+  }
+
+  void releaseRetiredFilters() {
+    // 没有并发的读取时调用
+    for (auto &item : m_retiredFilters) {
+      releaseFilter(item.first);
+    }
+    m_retiredFilters.clear();
+  }
+
+  void addToFilter(uint32_t hashCode) {
+    // 先读 m_pendingFilter：读到空时，m_filter 已是替换后的 filter，或者本节点
+    // 之后才会分裂
+    CBloomFilter *pending = m_pendingFilter;
+    CBloomFilter *filter = m_filter;
+    if (pending != nullptr) {
+      pending->add(hashCode, m_cocurrent);
+    }
+    if (filter != nullptr && filter != pending) {
+      filter->add(hashCode, m_cocurrent);
+    }
+  }
+
+  void addNodeToFilter(CBloomFilter *filter, const HashNode *node) {
+    for (int i = 0; i < node->getCount(); i++) {
+      filter->add(node->getCode(i), m_cocurrent);
+    }
+  }
+
+  void rebuildFilter() {
+    // 按现有数据重建 filter，调用时没有扩容及并发的 add
+    CBloomFilter *filter = newFilter(m_nextEnlargingSize);
+    int count = m_usedTableEntries * m_nodeCountPerChunk;
+    for (int i = 0; i < count && i <= getMask(); i++) {
+      addNodeToFilter(filter, getNode(i));
+    }
+    CBloomFilter *old = m_filter;
+    m_filter = filter;
+    m_removedSinceBuild = 0;
+    retireFilter(old);
+  }
+
+  void cocurrentRebuildFilter() {
+    // 与 add、remove 并发时重建 filter，方式与扩容相同：先设置 m_pendingFilter
+    // （之后在节点锁内的 add 同时写入新旧 filter），再逐个节点加锁写入已有的
+    // 数据，最后替换。期间 m_enlarging 为 1，不会开始扩容（同样使用
+    // m_pendingFilter），也不会有其他线程同时重建
+    m_rwmutex.lock();
+    if (m_enlarging != 0 || m_filter == nullptr) {
+      m_rwmutex.unlock();
+      return;
+    }
+    m_enlarging = 1;
+    m_removedSinceBuild = 0;
+    m_pendingFilter = newFilter(m_nextEnlargingSize);
+    m_rwmutex.unlock();
+
+    CBloomFilter *filter = m_pendingFilter;
+    for (int i = 0; i <= m_status.hashMask; i++) {
+      HashNode *node = getNode(i);
+      node->lock();
+      addNodeToFilter(filter, node);
+      node->unlock();
+    }
+
+    m_rwmutex.lock();
+    CBloomFilter *old = m_filter;
+    m_filter = filter;
+    m_pendingFilter = nullptr;
+    m_enlarging = 0;
+    retireFilter(old);
+    m_rwmutex.unlock();
+
+    // 重建期间的 add 不会触发扩容，这里补充检查
+    tryEnlargeHashTable();
+  }
+
+  static bool isSplit(const uint64_t *bits, int capacity, int index) {
+    // 位图属于其他容量（上一轮扩容）时，本轮扩容尚未分裂任何节点
+    return bits != nullptr && bits[0] == (uint64_t)capacity &&
+           ((bits[1 + (index >> 6)] >> (index & 63)) & 1);
+  }
+
+  int getNodeIndex(uint32_t hashCode) const {
+    // 单线程下 hashCode 所在的节点：扩容中且已经分裂的节点，高位为 1 的数据
+    // 在高区
+    int hashMask = m_status.hashMask;
+    int hashIndex = hashCode & hashMask;
+    if ((hashCode & (hashMask + 1)) &&
+        isSplit(m_splitBits, hashMask + 1, hashIndex)) {
+      hashIndex += hashMask + 1;
+    }
+    return hashIndex;
+  }
+
+  void dump(const char *msg) const {
+    int64_t expected = m_count.sum();
+    LOG_INFO("dump %s, capacity=%d, count=%ld\n", msg, m_status.hashMask + 1,
+             expected);
+    int64_t count = 0;
+    char buf[256] = {0};
+    for (int i = 0; i <= m_status.hashMask; i++) {
+      sprintf(buf, "[%d]: ", i);
+      HashNode *node = getNode(i);
+      node->dump(buf);
+      count += node->getCount();
     }
+    LOG_INFO("dump finish: %ld (expected: %ld)\n", count, expected);
+    assert(count == expected);
   }
 };
 
-class SliceHashNode : public HashNodeBase {
-
-  using HashNode = SliceHashNode;
+template <class T, class Hasher = CalcHash> class SwissPartitionImpl {
+  // 开放寻址的分区实现：节点为 SwissHashNode（一组数据），按组做三角探测。
+  // 与 PartitionImpl 相比，没有每个节点的锁、计数及溢出指针，也不保存
+  // hashCode，内存约为链式节点的一半。扩容时整体重建（需要重新计算 hashCode）
+  // 线程安全版本中，修改加分区写锁，查找加读锁（多个读者可以并行）
 
-  struct ItemInfo {
-    uint32_t code;
-    uint16_t len; //
-    uint16_t off; // 从尾部计算的距离，（使得可以整块负责数据）
-  };
+  using Partition = SwissPartitionImpl<T, Hasher>;
+  using HashNode = SwissHashNode<T, Hasher>;
+  using AutoLock = CAutoLock<CRWLock>;
+  using AutoSharedLock = CAutoSharedLock<CRWLock>;
 
 private:
-  unsigned char *m_pBuffer; // Info1, 2, ..., (..free..) (m_offset)..., Data1
-  uint32_t m_usedSpace;     // 以及占用的空间
+  HashNode *m_groups{nullptr};
+  bool m_mapped{false}; // m_groups 为快照映射的内存，不释放
+  int m_hashMask{0};
+  int m_count{0};
+  int m_nextEnlargingSize{0};
+  bool m_cocurrent{false};
+  int m_partIndex{0};
+  int m_initGroupBits{0};
+  AllocPolicy m_policy;
+
+  mutable CRWLock m_rwmutex;
 
 public:
-  Slice getValue(int index) const {
-    ItemInfo *pItem = getItem(index);
-    return Slice{pItem->len, m_pBuffer + m_capacity - pItem->off};
+  SwissPartitionImpl(bool cocurrent, int partIndex, int initCapacityBits,
+                     const AllocPolicy &policy = AllocPolicy())
+      : m_cocurrent(cocurrent), m_partIndex(partIndex), m_policy(policy) {
+    // 每组约 12 项，与链式节点（每个约 2.8 项）的初始容量相当
+    m_initGroupBits = initCapacityBits > 2 ? initCapacityBits - 2 : 0;
+    allocGroups(m_initGroupBits);
   }
 
-  uint32_t getCode(int index) const {
-    const ItemInfo *pItem = getItem(index);
-    return pItem->code;
-  }
+  ~SwissPartitionImpl() { releaseGroups(); }
 
-  int32_t find(const Slice &v) const {
-    for (int i = 0; i < m_count; i++) {
-      ItemInfo *pItem = getItem(i);
-      if (v.len == pItem->len &&
-          memcmp(m_pBuffer + m_capacity - pItem->off, v.buf, pItem->len) == 0)
-        return i;
+  void clear() {
+    if (m_cocurrent) {
+      AutoLock lock(&m_rwmutex);
+      return _clear();
     }
-    return -1;
+    return _clear();
   }
 
-  bool remove(const Slice &v, uint32_t hashCode) {
-    int index = find(v);
-    if (index < 0) {
-      return false;
-    }
-    if (index < m_count - 1) {
-      // 删除中间的，把最后一个 itemInfo填写到当前位置
-      // 其余内存不做修改和移动（也不会重新利用原先的内存）
-      ItemInfo *p = getItem(index);
-      *p = *getItem(m_count - 1);
-    }
+  HashNode *getNode(int index) const { return m_groups + index; }
 
-    m_count--;
-    return true;
+  int getMask() const { return m_hashMask; }
+
+  void prefetch(uint32_t hashCode) const {
+    // tag 及数据可能在两个 cache line 中
+    const char *p = (const char *)getNode(hashCode & m_hashMask);
+    __builtin_prefetch(p);
+    __builtin_prefetch(p + sizeof(HashNode) - 1);
   }
 
-  bool safeAdd(CBufferManager *pBufMgr, const Slice &v, uint32_t hashCode) {
-    if (this->find(v) >= 0) {
-      return false;
+  int64_t size() const { return m_count; }
+
+  // 扩容时整体重建，不支持渐进扩容
+  void setIncrementalRehash(bool incremental) {}
+
+  // 组内的 tag 已起到过滤作用，不使用 Bloom filter
+  void setPrefilter(bool prefilter) {}
+
+  void finishRehash() {}
+
+  bool add(const T &v, uint32_t hashCode) {
+    if (m_cocurrent) {
+      AutoLock lock(&m_rwmutex);
+      return _add(v, hashCode);
     }
-    int needSpace = sizeof(ItemInfo) + getAlignedSize(v.len) + getUsedSpace();
-    if (m_capacity == 0) {
-      int capacity = calcNeedCapacity(needSpace);
-      m_pBuffer = pBufMgr->alloc(capacity);
-      m_capacity = capacity;
-    } else if (m_capacity < needSpace) {
-      // 已有扩展内存块，需要扩容
-      int capacity = calcNeedCapacity(needSpace);
-      unsigned char *pBuffer = pBufMgr->alloc(capacity);
-      // 复制现有数据。（记录的offset为从尾部开始计算，因此相对位置不变，无需逐项更新）
-      memcpy(pBuffer + capacity - m_usedSpace,
-             m_pBuffer + m_capacity - m_usedSpace, m_usedSpace);
-      // 复制DataItem信息。（尾部对齐）
-      memcpy(pBuffer, m_pBuffer, m_count * sizeof(ItemInfo));
+    return _add(v, hashCode);
+  }
 
-      unsigned char *pOldBuf = m_pBuffer;
-      int bufLen = m_capacity;
+  int find(const T &v, uint32_t hashCode, int &hashIndex) const {
+    if (m_cocurrent) {
+      AutoSharedLock lock(&m_rwmutex);
+      return _find(v, hashCode, hashIndex);
+    }
+    return _find(v, hashCode, hashIndex);
+  }
 
-      m_pBuffer = pBuffer;
-      m_capacity = capacity;
+  // 预先扩容到 count 项不超过扩容阈值，只重新插入一次（不支持并发）
+  void reserve(int64_t count) {
+    int growBits = 0;
+    while ((int64_t)m_nextEnlargingSize << growBits < count) {
+      growBits++;
+    }
+    if (growBits > 0) {
+      enlargeHashTable(growBits);
+    }
+  }
 
-      // delay dealloc here, when node is ready (for thread-safe)
-      pBufMgr->dealloc(pOldBuf, bufLen);
+  // 收缩：数据较少时按减半后的组数整体重建，返回释放的字节数。
+  // 线程安全版本中加分区锁；快照映射的分区不收缩
+  size_t compact() {
+    if (m_cocurrent) {
+      AutoLock lock(&m_rwmutex);
+      return _compact();
     }
-    put(m_count, v, hashCode, m_usedSpace);
-    m_count++;
-    return true;
+    return _compact();
   }
 
-  int split(CBufferManager *pBufMgr, HashNode *other, int capacity) {
-    // 在rehash时，运行并行加入的同样数据，加入到新节点或老节点，因此这里返回
-    // 迁移节点时的重复个数
-    int newCount = 0;
-    int dupCount = 0;
-    uint32_t usedSpace = 0;
-    Slice v;
-    for (int index = 0; index < m_count; index++) {
-      ItemInfo *pInfo = getItem(index);
-      v.len = pInfo->len;
-      v.buf = getValuePtr(pInfo);
-      if (pInfo->code & capacity) {
-        if (!other->safeAdd(pBufMgr, v, pInfo->code)) {
-          dupCount++;
-        }
-      } else {
-        if (index != newCount) {
-          // move forward
-          put(newCount, v, pInfo->code, usedSpace);
-        } else {
-          // 无需复制数据
-          usedSpace += getAlignedSize(v.len);
+  int addAll(Partition *pSrc) {
+    // 本函数不支持并发，this和 pSrc均不存在其他线程的修改
+    // 与链式分区相同，按两者中较大者扩容
+    reserve(std::max(m_count, pSrc->m_count));
+    int n = 0;
+    for (int srcIndex = 0; srcIndex <= pSrc->m_hashMask; srcIndex++) {
+      HashNode *srcNode = pSrc->getNode(srcIndex);
+      for (int i = 0; i < srcNode->getCount(); i++) {
+        if (this->_add(srcNode->getValue(i), srcNode->getCode(i))) {
+          n++;
         }
-
-        newCount++;
       }
     }
-    m_count = newCount;
-    m_usedSpace = usedSpace;
-    return dupCount;
+    return n;
   }
 
-  void dump(const char *msg) const {
-    LOG_INFO("%s: Node_%p:(lock=%u,cap=%d,cnt=%d):", msg, this, m_lock,
-             m_capacity, m_count);
-    for (int i = 0; i < m_count; i++) {
-      LOG_INFO(" %x", getCode(i));
+  bool remove(const T &v, uint32_t hashCode) {
+    if (m_cocurrent) {
+      AutoLock lock(&m_rwmutex);
+      return _remove(v, hashCode);
     }
-    LOG_INFO("\n");
+    return _remove(v, hashCode);
   }
 
-  bool debug_verify(int hashIndex, int hashMask) const {
-    for (int i = 0; i < m_count; i++) {
-      if (!debug_verify(hashIndex, hashMask, i)) {
+  bool save(CSnapshotFile &file, SnapshotPartition &part) const {
+    // 组内没有指针，直接写入全部组。本函数不支持并发
+    part.hashMask = m_hashMask;
+    part.count = m_count;
+    part.nodeCount = m_hashMask + 1;
+    part.nodeOffset = file.align();
+    part.chunkOffset = part.nodeOffset;
+    part.chunkCount = 0;
+    return part.nodeOffset >= 0 &&
+           file.write(m_groups, sizeof(HashNode) * part.nodeCount);
+  }
+
+  bool load(CSnapshotFile &file, const SnapshotPartition &part) {
+    // 映射模式下直接使用文件映射的内存。本函数不支持并发，失败时需要调用 clear
+    if (part.nodeCount != (int64_t)part.hashMask + 1 ||
+        (part.nodeCount & part.hashMask) != 0) {
+      return false;
+    }
+    int64_t bytes = sizeof(HashNode) * part.nodeCount;
+    releaseGroups();
+    if (file.isMapped()) {
+      m_groups = (HashNode *)file.at(part.nodeOffset, bytes);
+      m_mapped = m_groups != nullptr;
+    } else {
+      m_groups = allocGroupMemory(part.nodeCount);
+      m_hashMask = part.hashMask; // 读取失败时，clear 按 m_hashMask 释放
+      if (!file.read(part.nodeOffset, m_groups, bytes)) {
         return false;
       }
     }
-    return true;
-  }
-
-  bool debug_verify(int hashIndex, int hashMask, int item) const {
-    uint32_t hashCode = getCode(item);
-    int expectedIndex = hashCode & hashMask;
-    if (expectedIndex != hashIndex) {
-      char buf[256] = {0};
-      sprintf(buf, "inconsist hash value: %x: (%x & %x) != %x, diff=%x",
-              expectedIndex, hashCode, hashMask, hashIndex,
-              expectedIndex ^ hashIndex);
-      dump(buf);
+    if (m_groups == nullptr) {
+      allocGroups(m_initGroupBits);
       return false;
     }
+    m_hashMask = part.hashMask;
+    m_count = part.count;
+    m_nextEnlargingSize = SWISS_MAX_LOAD * (m_hashMask + 1);
     return true;
   }
 
-private:
-  int32_t getAlignedSize(int size) const { return (size + 7) & 0x7ffffff8; }
-
-  int32_t calcNeedCapacity(int need) const {
-    int capacity = m_capacity ? m_capacity : 64;
-    while (capacity < need) {
-      capacity = capacity << 1;
+  void getMemoryUsage(MemoryUsage &usage) const {
+    if (!m_mapped) {
+      usage.nodeTable += CPageAllocator::getAllocSize(
+          sizeof(HashNode) * (m_hashMask + 1), m_policy);
     }
-    return capacity;
+    usage.overhead += sizeof(*this);
   }
 
-  void put(int index, const Slice &v, uint32_t hashCode, uint32_t &usedSpace) {
-    // call put before m_count is increased
-    ItemInfo *pInfo = getItem(index);
-    usedSpace += getAlignedSize(v.len);
-    pInfo->code = hashCode;
-    pInfo->len = v.len;
-    pInfo->off = usedSpace;
-    // split时，内存可能出现overlap
-    memmove(getValuePtr(pInfo), v.buf, v.len);
+  int debug_verify(int partIndex) const {
+    int nErrCount = 10;
+    int total = 0;
+    for (int i = 0; i <= m_hashMask; i++) {
+      auto node = getNode(i);
+      total += node->getCount();
+      if (!node->debug_verify(i, m_hashMask) && --nErrCount == 0) {
+        break;
+      }
+    }
+    return total;
   }
 
-  ItemInfo *getItem(int index) const { return (ItemInfo *)m_pBuffer + index; }
-
-  unsigned char *getValuePtr(ItemInfo *pItem) const {
-    return m_pBuffer + m_capacity - pItem->off;
+  void dump_stat(const char *msg) const {
+    int hist[SWISS_GROUP_SIZE + 1]{0};
+    int overflow = 0;
+    for (int i = 0; i <= m_hashMask; i++) {
+      auto node = getNode(i);
+      hist[node->getCount()]++;
+      overflow += node->hasOverflow() ? 1 : 0;
+    }
+    LOG_INFO("%s groups=%d count=%d overflow=%d hist=[%d", msg, m_hashMask + 1,
+             m_count, overflow, hist[0]);
+    for (int i = 1; i <= SWISS_GROUP_SIZE; i++) {
+      LOG_INFO(",%d", hist[i]);
+    }
+    LOG_INFO("]\n");
   }
 
-  int32_t getUsedSpace() const {
-    return sizeof(ItemInfo) * m_count + m_usedSpace;
+private:
+  void _clear() {
+    releaseGroups();
+    allocGroups(m_initGroupBits);
   }
-};
-
-template <class T, class HashNode> class PartitionImpl {
 
-  using Partition = PartitionImpl<T, HashNode>;
-  using NodeAutoLock = CAutoLock<HashNode>;
+  void releaseGroups() {
+    if (!m_mapped) {
+      freeGroupMemory(m_groups, m_hashMask + 1);
+    }
+    m_groups = nullptr;
+    m_mapped = false;
+  }
 
-private:
-  // 多个线程访问，需要同步，避免编译器优化
-  // 扩容完成时，对hashMask及rehashedIndex的修改需要一次完成
-  union EnlargeStatus {
-    uint64_t value;
-    struct {
-      int hashMask;
-      int rehashedIndex;
-    };
-  };
-  volatile EnlargeStatus m_status;
-  volatile int m_enlarging{0};
-  volatile int m_count{0};
+  HashNode *allocGroupMemory(int64_t count) {
+    HashNode *groups = (HashNode *)CPageAllocator::alloc(
+        sizeof(HashNode) * count, m_policy, m_partIndex);
+    if (groups == nullptr) {
+      throw std::bad_alloc();
+    }
+    return groups;
+  }
 
-  int m_tableSize{0};
-  int m_usedTableEntries{0};
-  HashNode **m_table{nullptr};
-  CBufferManager *m_bufMgr{nullptr};
-  bool m_cocurrent{false};
-  int m_nextEnlargingSize{0};
-  int m_partIndex{0};
+  void freeGroupMemory(HashNode *groups, int64_t count) {
+    CPageAllocator::release(groups, sizeof(HashNode) * count, m_policy);
+  }
 
-  int m_initCapacityBits{0};
-  int m_nodeCountPerChunk{0};
+  void allocGroups(int groupBits) {
+    // 之前的 m_groups 由调用者释放
+    int count = 1 << groupBits;
+    m_groups = allocGroupMemory(count);
+    m_hashMask = count - 1;
+    m_count = 0;
+    m_nextEnlargingSize = SWISS_MAX_LOAD * count;
+  }
 
-  std::mutex m_rwmutex;
+  int _find(const T &v, uint32_t hashCode, int &hashIndex) const {
+    uint8_t tag = HashNode::getTag(hashCode);
+    int index = hashCode & m_hashMask;
+    for (int step = 1; step <= m_hashMask + 1; step++) {
+      const HashNode *node = getNode(index);
+      int itemIndex = node->find(v, tag);
+      if (itemIndex >= 0) {
+        hashIndex = index;
+        return itemIndex;
+      }
+      if (!node->hasOverflow()) {
+        break;
+      }
+      // 三角探测，组数为2的幂时可以遍历全部组
+      index = (index + step) & m_hashMask;
+    }
+    return -1;
+  }
 
-#ifdef DEBUG_VERIFY_AFTER_ENLARGE
-  volatile bool m_blocking{false};
-#endif
+  size_t _compact() {
+    // 与链式分区相同，收缩后的个数不超过扩容阈值的一半
+    int groupBits = getGroupBits();
+    int target = groupBits;
+    while (target > m_initGroupBits &&
+           (int64_t)m_count * 2 <= (int64_t)SWISS_MAX_LOAD << (target - 1)) {
+      target--;
+    }
+    if (m_mapped || target == groupBits) {
+      return 0;
+    }
+    rebuild(target);
+    return CPageAllocator::getAllocSize(sizeof(HashNode) << groupBits,
+                                        m_policy) -
+           CPageAllocator::getAllocSize(sizeof(HashNode) << target, m_policy);
+  }
 
-public:
-  PartitionImpl(bool cocurrent, int partIndex, int initCapacityBits)
-      : m_cocurrent(cocurrent), m_partIndex(partIndex),
-        m_initCapacityBits(initCapacityBits) {
+  bool _add(const T &v, uint32_t hashCode) {
+    int hashIndex = 0;
+    if (_find(v, hashCode, hashIndex) >= 0) {
+      return false;
+    }
+    if (m_count >= m_nextEnlargingSize) {
+      enlargeHashTable();
+    }
+    insert(v, hashCode);
+    m_count++;
+    return true;
+  }
 
-    m_nodeCountPerChunk = 1 << initCapacityBits;
+  void insert(const T &v, uint32_t hashCode) {
+    // 调用前已确认数据不存在，且存在空位
+    int index = hashCode & m_hashMask;
+    for (int step = 1;; step++) {
+      HashNode *node = getNode(index);
+      if (!node->isFull()) {
+        node->put(v, HashNode::getTag(hashCode));
+        return;
+      }
+      node->incOverflow();
+      index = (index + step) & m_hashMask;
+    }
+  }
 
-    m_tableSize = (1 << (MAX_CAPACITY_BITS - initCapacityBits + 1));
-    m_table = new HashNode *[m_tableSize];
-    m_bufMgr = new CBufferManager(cocurrent);
+  bool _remove(const T &v, uint32_t hashCode) {
+    int hashIndex = 0;
+    int itemIndex = _find(v, hashCode, hashIndex);
+    if (itemIndex < 0) {
+      return false;
+    }
+    getNode(hashIndex)->removeAt(itemIndex);
+    // 探测路径上经过的组，溢出计数减一
+    int index = hashCode & m_hashMask;
+    for (int step = 1; index != hashIndex; step++) {
+      getNode(index)->decOverflow();
+      index = (index + step) & m_hashMask;
+    }
+    m_count--;
+    return true;
+  }
 
-    allocNodeChunk(1);
-    m_status.hashMask = (1 << m_initCapacityBits) - 1;
-    m_status.rehashedIndex = -1;
-    m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+  int getGroupBits() const {
+    int groupBits = 0;
+    while ((1 << groupBits) <= m_hashMask) {
+      groupBits++;
+    }
+    return groupBits;
   }
 
-  ~PartitionImpl() {
-    _clear(false);
-    delete[] m_table;
-    delete m_bufMgr;
+  void enlargeHashTable(int growBits = 1) {
+    // 按当前容量翻倍（growBits 次）
+    rebuild(getGroupBits() + growBits);
   }
 
-  void clear() { _clear(true); }
-
-  HashNode *getNode(int index) const {
-    // assert((index >> m_initCapacityBits) < this->m_usedTableEntries);
-    return m_table[index >> m_initCapacityBits] +
-           (index & (m_nodeCountPerChunk - 1));
+  void rebuild(int groupBits) {
+    // 按 2^groupBits 个组重新申请，全部数据重新插入
+    HashNode *oldGroups = m_groups;
+    int oldMask = m_hashMask;
+    int count = m_count;
+    allocGroups(groupBits);
+    for (int i = 0; i <= oldMask; i++) {
+      HashNode *node = oldGroups + i;
+      for (int k = 0; k < node->getCount(); k++) {
+        insert(node->getValue(k), node->getCode(k));
+      }
+    }
+    m_count = count;
+    if (m_mapped) {
+      m_mapped = false;
+    } else {
+      freeGroupMemory(oldGroups, oldMask + 1);
+    }
   }
+};
 
-  int getMask() const { return m_status.hashMask; }
+// 溢出文件（run）格式：SpillRunHeader，之后依次为 hashCode 数组、数据数组及
+// Bloom filter（后两者按 8 字节对齐）。数据按 (hashCode, 数据) 排序
+struct SpillRunHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t valueSize;
+  int64_t count;
+  int64_t valueOffset;
+  int64_t bloomOffset;
+  int64_t bloomBlocks;
+};
 
-  int size() const { return m_count; }
+template <class T> class CSpillRun {
+  // 磁盘上的一个 run，创建后不再修改。查询时使用整个文件的映射：先检查
+  // Bloom filter，再二分查找 hashCode。对象释放时删除文件
+  using RunPtr = std::shared_ptr<CSpillRun<T>>;
+  using Item = std::pair<uint32_t, T>;
+
+  std::string m_path;
+  unsigned char *m_pData{nullptr};
+  int64_t m_size{0};
+  bool m_mapped{false};
+  int64_t m_count{0};
+  const uint32_t *m_codes{nullptr};
+  const T *m_values{nullptr};
+  CBloomFilter m_bloom;
 
-  bool add(const T &v, uint32_t hashCode) {
-    int hashIndex = hashCode & m_status.hashMask;
-    if (!m_cocurrent) {
-      HashNode *node = this->getNode(hashIndex);
-      if (node->safeAdd(m_bufMgr, v, hashCode)) {
-        m_count++;
-        tryEnlargeHashTable();
-        return true;
-      }
-      return false;
+public:
+  ~CSpillRun() {
+    if (m_mapped) {
+      CSnapshotFile::unmap(m_pData, m_size);
+    } else {
+      free(m_pData);
     }
+    ::remove(m_path.c_str());
+  }
 
-    return cocurrentAdd(v, hashCode);
+  // 由排序后的 (hashCode, 数据) 创建 run，失败返回空
+  static CSpillRun *create(const std::string &path,
+                           const std::vector<Item> &items) {
+    VectorSource src{items, 0};
+    return create(path, items.size(), src);
   }
 
-#ifdef DEBUG_VERIFY_AFTER_ENLARGE
-  bool waitForUnblock() {
-    while (m_blocking) {
-      usleep(100);
+  // 归并多个 run（数据互不重复），失败返回空
+  static CSpillRun *merge(const std::string &path,
+                          const std::vector<RunPtr> &runs) {
+    MergeSource src{runs, std::vector<int64_t>(runs.size(), 0)};
+    int64_t count = 0;
+    for (auto &run : runs) {
+      count += run->size();
     }
-    return true;
+    return create(path, count, src);
   }
-#endif
 
-  bool cocurrentAdd(const T &v, uint32_t hashCode) {
-    // 利用 rehashedIndex 的值，来避免上锁（m_rwmutex）
-    // 未扩区时，rehashedIndex = -1。（此时高区不可用，或无任何顶点已经分裂）
-    // 扩区过程中 rehashedIndex 为实际完成分裂的节点编号。（高区可用）
-    // 扩区结束时，hashMask 与 rehashedIndex 同时更新
-    // 取到node锁后，rehashedIndex 不会出现增加超过当前节点的情况
-    //    可以保证：当前需要操作的node要不然完成分裂，要不尚未开始分裂
+  bool contains(const T &v, uint32_t hashCode) const {
+    if (!m_bloom.mayContain(hashCode)) {
+      return false;
+    }
+    const uint32_t *end = m_codes + m_count;
+    const uint32_t *p = std::lower_bound(m_codes, end, hashCode);
+    for (; p != end && *p == hashCode; ++p) {
+      if (m_values[p - m_codes] == v) {
+        return true;
+      }
+    }
+    return false;
+  }
 
-#ifdef DEBUG_VERIFY_AFTER_ENLARGE
-    waitForUnblock();
-#endif
+  int64_t size() const { return m_count; }
 
-    uint32_t hashMask = m_status.hashMask;
-    int hashIndex = hashCode & hashMask;
-    HashNode *node = this->getNode(hashIndex);
-    node->lock();
-    // 在加锁过程中，可能已经完成多轮扩区
-    while (hashMask != m_status.hashMask) {
-      node->unlock();
-      hashMask = m_status.hashMask;
-      hashIndex = hashCode & hashMask;
-      node = this->getNode(hashIndex);
-      node->lock();
-    }
+  int64_t getFileSize() const { return m_size; }
 
-    if (hashCode & (hashMask + 1)) {
-      // 扩区中，新的值属于分裂后的新节点，可能需加入到分裂后的新节点
-      EnlargeStatus s;
-      s.value = m_status.value;
-      if ((hashIndex <= s.rehashedIndex) ||
-          (s.rehashedIndex == -1 && hashMask != s.hashMask)) {
-        // 第一个条件：扩区进行中，且当前节点已经分裂。(不管mask是否已经更新)
-        // 第二个条件：自从获取 hashMask 后，扩区刚完成
-        hashIndex = hashIndex + hashMask + 1;
-        HashNode *node2 = this->getNode(hashIndex);
-        node2->lock();
-        node->unlock();
-        node = node2;
+private:
+  explicit CSpillRun(const std::string &path) : m_path(path) {}
+
+  struct VectorSource {
+    const std::vector<Item> &items;
+    size_t pos;
+
+    void reset() { pos = 0; }
+
+    bool next(uint32_t &code, T &value) {
+      if (pos >= items.size()) {
+        return false;
       }
+      code = items[pos].first;
+      value = items[pos].second;
+      pos++;
+      return true;
     }
-    bool ret = node->safeAdd(m_bufMgr, v, hashCode);
-    if (ret) {
-      // 放在这里，m_count 才正确？？？！！！
-      Atomic::Add(&m_count, 1);
-    }
-    node->unlock();
+  };
 
-    if (ret) {
-      // 放在这里，不正确？？
-      // Atomic::Add(&m_count, 1);
-      tryEnlargeHashTable();
+  struct MergeSource {
+    // run 的个数很少（SPILL_MERGE_RUNS），每次顺序比较各 run 的当前项
+    const std::vector<RunPtr> &runs;
+    std::vector<int64_t> pos;
+
+    void reset() { std::fill(pos.begin(), pos.end(), 0); }
+
+    bool next(uint32_t &code, T &value) {
+      // 从第一个未读完的 run 开始比较，最后一次写入 code、value
+      int best = -1;
+      uint32_t bestCode = 0;
+      const T *bestValue = nullptr;
+      for (size_t i = 0; i < runs.size(); i++) {
+        if (pos[i] >= runs[i]->m_count) {
+          continue;
+        }
+        uint32_t c = runs[i]->m_codes[pos[i]];
+        const T *v = &runs[i]->m_values[pos[i]];
+        if (best < 0 || c < bestCode || (c == bestCode && *v < *bestValue)) {
+          best = i;
+          bestCode = c;
+          bestValue = v;
+        }
+      }
+      if (best < 0) {
+        return false;
+      }
+      code = bestCode;
+      value = *bestValue;
+      pos[best]++;
+      return true;
     }
+  };
 
-    return ret;
+  template <class Source>
+  static CSpillRun *create(const std::string &path, int64_t count,
+                           Source &src) {
+    if (!write(path, count, src)) {
+      LOG_ERROR("write spill run failed: %s\n", path.c_str());
+      ::remove(path.c_str());
+      return nullptr;
+    }
+    CSpillRun *run = new CSpillRun(path);
+    if (!run->open()) {
+      LOG_ERROR("open spill run failed: %s\n", path.c_str());
+      delete run;
+      return nullptr;
+    }
+    return run;
   }
 
-  int find(const T &v, uint32_t hashCode, int &hashIndex) const {
-    int hashMask = m_status.hashMask;
-    hashIndex = hashCode & hashMask;
-    int32_t itemIndex = getNode(hashIndex)->find(v);
-    if (itemIndex < 0) {
-      // 目标分区可能正在扩区。（内存已经ready）。
-      // 由于node不加锁，只要高区可用就需要搜索高区
-      if (m_cocurrent && m_enlarging == 2 && (hashCode & (hashMask + 1))) {
-        // 存在扩表，且当前节点可能存在移动
-        // 检查新节点，不用锁定
-        hashIndex = hashIndex + hashMask + 1;
-        return getNode(hashIndex)->find(v);
+  template <class Source>
+  static bool write(const std::string &path, int64_t count, Source &src) {
+    // 先写 hashCode 并生成 Bloom filter，再从头遍历一次写数据
+    const int BATCH = 4096;
+    CSnapshotFile file;
+    if (!file.create(path.c_str())) {
+      return false;
+    }
+    SpillRunHeader header;
+    initHeader(header);
+    header.count = count;
+    header.valueOffset = alignUp(sizeof(header) + sizeof(uint32_t) * count);
+    header.bloomOffset = alignUp(header.valueOffset + sizeof(T) * count);
+    CBloomFilter bloom;
+    bloom.init(count);
+    header.bloomBlocks = bloom.getBlockCount();
+    bool ok = file.write(&header, sizeof(header));
+
+    uint32_t codes[BATCH];
+    T values[BATCH];
+    uint32_t code;
+    T value;
+    src.reset();
+    for (int64_t i = 0; ok && i < count; i += BATCH) {
+      int n = (int)std::min<int64_t>(BATCH, count - i);
+      for (int k = 0; ok && k < n; k++) {
+        ok = src.next(codes[k], value);
+        bloom.add(codes[k]);
       }
+      ok = ok && file.write(codes, sizeof(uint32_t) * n);
     }
-    return itemIndex;
-  }
-
-  int addAll(Partition *pSrc) {
-    // 本函数不支持并发，this和 pSrc均不存在其他线程的修改
-    // 把src的全部内容加入到当前分区中。返回成功加入的个数
-    // 两者的 hashMask可能不同，因此需要逐个处理
-    int n = 0;
-    for (int srcIndex = 0; srcIndex <= pSrc->m_status.hashMask; srcIndex++) {
-      HashNode *srcNode = pSrc->getNode(srcIndex);
-      for (int i = 0; i < srcNode->getCount(); i++) {
-        if (this->add(srcNode->getValue(i), srcNode->getCode(i))) {
-          n++;
-        }
+    ok = ok && padTo(file, header.valueOffset);
+    src.reset();
+    for (int64_t i = 0; ok && i < count; i += BATCH) {
+      int n = (int)std::min<int64_t>(BATCH, count - i);
+      for (int k = 0; ok && k < n; k++) {
+        ok = src.next(code, values[k]);
       }
+      ok = ok && file.write(values, sizeof(T) * n);
     }
-    return n;
+    return ok && padTo(file, header.bloomOffset) &&
+           file.write(bloom.data(), bloom.getBytes());
   }
 
-  bool remove(const T &v, uint32_t hashCode) {
-    // 现有外部调用时，remove为单线程，且与add不会并发
-    // 为简化，这里只考虑与 add/remove 的并发操作，不考虑因add产生扩容时并发问题
-    // 最不好的结果是：在扩容时，可能不能正确删除
-    int hashIndex = hashCode & m_status.hashMask;
-    HashNode *node = this->getNode(hashIndex);
-    if (m_cocurrent) {
-      node->lock();
+  bool open() {
+    CSnapshotFile file;
+#ifndef _WIN32
+    if (file.open(m_path.c_str(), true)) {
+      m_pData = file.detachMapping(m_size);
+      m_mapped = true;
     }
-    bool ret = node->remove(v, hashCode);
-    if (m_cocurrent) {
-      node->unlock();
+#endif
+    if (!m_mapped) {
+      // 不能映射时读入内存
+      file.close();
+      if (!file.open(m_path.c_str(), false)) {
+        return false;
+      }
+      m_size = file.size();
+      m_pData = (unsigned char *)malloc(m_size);
+      if (m_pData == nullptr || !file.read(0, m_pData, m_size)) {
+        return false;
+      }
     }
 
-    if (ret) {
-      Atomic::Add(&m_count, -1);
+    SpillRunHeader header;
+    SpillRunHeader expected;
+    initHeader(expected);
+    if (m_size < (int64_t)sizeof(header)) {
+      return false;
     }
-    return ret;
+    memcpy(&header, m_pData, sizeof(header));
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version ||
+        header.valueSize != expected.valueSize ||
+        header.bloomOffset + header.bloomBlocks * 64 > m_size) {
+      return false;
+    }
+    m_count = header.count;
+    m_codes = (const uint32_t *)(m_pData + sizeof(header));
+    m_values = (const T *)(m_pData + header.valueOffset);
+    m_bloom.attach((const uint64_t *)(m_pData + header.bloomOffset),
+                   header.bloomBlocks);
+    return true;
   }
 
-  int debug_verify(int partIndex) const {
-    int nErrCount = 10;
-    int count = m_usedTableEntries * m_nodeCountPerChunk;
-    int total = 0;
-    int mid = (this->m_status.hashMask + 1) >> 1;
-    for (int i = 0; i < count; i++) {
-      auto node = getNode(i);
-      total += node->getCount();
-      if (!node->debug_verify(i, this->m_status.hashMask)) {
-        if (i < mid) {
-          auto node2 = getNode(i + mid);
-          char buf[256];
-          sprintf(buf, "high-part(%x)", i + mid);
-          node2->dump(buf);
-        }
-        if (--nErrCount == 0) {
-          break;
-        }
-      }
-    }
-    return total;
+  static void initHeader(SpillRunHeader &header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FASTRUN", 8);
+    header.version = 1;
+    header.valueSize = sizeof(T);
   }
 
-  void dump_stat(const char *msg) const {
-    struct {
-      int hist[4];   // for count is zero and one
-      int max_len;   // max len of node
-      int max_index; // node index with max len
-      long total;    // total len of node
-      long square;
-    } m{0};
+  static int64_t alignUp(int64_t offset) { return (offset + 7) & ~7LL; }
 
-    int count = m_usedTableEntries * m_nodeCountPerChunk;
-    for (int i = 0; i < count; i++) {
-      auto node = getNode(i);
-      int c = node->getCount();
-      m.total += c;
-      m.square += c * c;
+  static bool padTo(CSnapshotFile &file, int64_t offset) {
+    static const char zeros[8] = {0};
+    int64_t pad = offset - file.tell();
+    return pad >= 0 && pad <= 8 && (pad == 0 || file.write(zeros, pad));
+  }
+};
 
-      if (c > m.max_len) {
-        m.max_len = c;
-        m.max_index = i;
-      }
-      if (c < 4)
-        m.hist[c]++;
-    }
+template <class T> class CSpillStore {
+  // 溢出模式（见 FastHashSetImpl::setMemoryBudget）下各分区在磁盘上的 run。
+  // 分区占用的内存超过预算时，整个分区写成一个 run 并清空；大小相近的 run
+  // 达到 SPILL_MERGE_RUNS 个时，由后台线程合并为一个（size-tiered），使每个
+  // 分区的 run 数保持在 O(log n)。各 run 的数据互不重复
+  using SpillRun = CSpillRun<T>;
+  using RunPtr = std::shared_ptr<SpillRun>;
+  using AutoLock = CAutoLock<std::mutex>;
 
-    float avg = (float)m.total / count;
-    float std = sqrt((float)m.square / count - avg * avg);
-    LOG_INFO("%s nodes=%d max=%d(%d) avg=%.3f std=%.3f hist=[%d", msg, count,
-             m.max_len, m.max_index, avg, std, m.hist[0]);
-    for (int i = 1; i < 4; i++) {
-      LOG_INFO(",%d", m.hist[i]);
-    }
+  struct PartitionRuns {
+    mutable std::mutex mutex; // 保护 runs（后台合并时替换）
+    std::vector<RunPtr> runs;
+  };
 
-    this->m_bufMgr->dump_stat("]");
-  }
+  std::string m_dir;
+  size_t m_budget;
+  int m_partitionCount;
+  PartitionRuns *m_parts;
+  volatile int64_t m_count{0};
+  volatile int m_nextRunId{0};
 
-private:
-  void _clear(bool withInit) {
-    m_bufMgr->clear();
-    int toKeep = 0;
+  std::mutex m_mergeMutex; // 合并与 clear 互斥
+  std::mutex m_queueMutex; // 保护 m_pending 及 m_stop
+  std::condition_variable m_cond;
+  bool m_pending{false};
+  bool m_stop{false};
+  std::thread m_merger;
 
-    if (withInit) {
-      if (this->m_usedTableEntries > 0) {
-        // 重用1块内存，降低内存申请释放开销，及缺页中断机会
-        toKeep = 1;
-        memset(m_table[0], 0, sizeof(HashNode) * m_nodeCountPerChunk);
-      }
-      m_status.hashMask = (1 << m_initCapacityBits) - 1;
-      m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
+public:
+  CSpillStore(const char *dir, size_t budget, int partitionCount)
+      : m_dir(dir), m_budget(budget), m_partitionCount(partitionCount) {
+    m_parts = new PartitionRuns[partitionCount];
+    m_merger = std::thread([this] { mergeLoop(); });
+  }
+
+  ~CSpillStore() {
+    {
+      std::lock_guard<std::mutex> lock(m_queueMutex);
+      m_stop = true;
     }
+    m_cond.notify_one();
+    m_merger.join();
+    delete[] m_parts;
+  }
 
-    for (int i = toKeep; i < this->m_usedTableEntries; i++) {
-      delete[] m_table[i];
+  void setBudget(size_t budget) { m_budget = budget; }
+
+  size_t getPartitionBudget() const { return m_budget / m_partitionCount; }
+
+  size_t size() const { return m_count; }
+
+  int getRunCount() const {
+    int count = 0;
+    for (int i = 0; i < m_partitionCount; i++) {
+      AutoLock lock(&m_parts[i].mutex);
+      count += m_parts[i].runs.size();
     }
-    m_usedTableEntries = toKeep;
-    m_count = 0;
+    return count;
   }
 
-  void allocNodeChunk(int count = 1) {
-    // 除第一个外，之后每个都必须翻倍
-    assert(m_usedTableEntries == 0 || m_usedTableEntries == count);
-    assert(m_usedTableEntries + count < this->m_tableSize);
-    for (int i = 0; i < count; i++) {
-      HashNode *nodes = new HashNode[m_nodeCountPerChunk];
-      memset(nodes, 0, sizeof(HashNode) * m_nodeCountPerChunk);
-      m_table[m_usedTableEntries] = nodes;
-      m_usedTableEntries++;
+  bool contains(int partIndex, const T &v, uint32_t hashCode) const {
+    const PartitionRuns &part = m_parts[partIndex];
+    AutoLock lock(&part.mutex);
+    for (auto &run : part.runs) {
+      if (run->contains(v, hashCode)) {
+        return true;
+      }
     }
+    return false;
   }
 
-  bool needEnlargeHashTable() const {
-    if (m_enlarging || m_count <= m_nextEnlargingSize)
+  // 把分区的数据写成一个 run（items 会被排序），失败时返回 false
+  bool addRun(int partIndex, std::vector<std::pair<uint32_t, T>> &items) {
+    if (items.empty()) {
+      return true;
+    }
+    std::sort(items.begin(), items.end());
+    RunPtr run(SpillRun::create(newPath(partIndex), items));
+    if (!run) {
       return false;
-
+    }
+    {
+      AutoLock lock(&m_parts[partIndex].mutex);
+      m_parts[partIndex].runs.push_back(run);
+    }
+    __sync_fetch_and_add(&m_count, (int64_t)items.size());
+    {
+      std::lock_guard<std::mutex> lock(m_queueMutex);
+      m_pending = true;
+    }
+    m_cond.notify_one();
     return true;
   }
 
-  void tryEnlargeHashTable() {
-    // 检查扩容需要加锁，先检查一次
-    if (!needEnlargeHashTable())
-      return;
-
-    if (m_cocurrent) {
-      m_rwmutex.lock();
+  // 在当前线程完成所有可以进行的合并
+  void mergeRuns() {
+    AutoLock lock(&m_mergeMutex);
+    while (mergeOnce()) {
     }
+  }
 
-    // 加锁后，重复检查
-    if (needEnlargeHashTable()) {
-      // 拒绝其他线程进入
-      m_enlarging = 1;
-      assert(m_status.rehashedIndex == -1);
-      int capacity = m_status.hashMask + 1;
+  void clear() {
+    // 等待进行中的合并结束，删除全部 run
+    AutoLock lock(&m_mergeMutex);
+    for (int i = 0; i < m_partitionCount; i++) {
+      AutoLock partLock(&m_parts[i].mutex);
+      m_parts[i].runs.clear();
+    }
+    m_count = 0;
+  }
 
-      if (m_cocurrent) {
-        m_rwmutex.unlock();
+  void getMemoryUsage(MemoryUsage &usage) const {
+    // run 文件为映射的内存（可由系统换出），计入 mapped
+    usage.overhead += sizeof(*this) + sizeof(PartitionRuns) * m_partitionCount;
+    for (int i = 0; i < m_partitionCount; i++) {
+      AutoLock lock(&m_parts[i].mutex);
+      for (auto &run : m_parts[i].runs) {
+        usage.mapped += run->getFileSize();
       }
+    }
+  }
 
-      // 耗时操作开始（已经解锁）
-      this->enlargeHashTable(capacity);
+private:
+  std::string newPath(int partIndex) {
+    char name[128];
+    snprintf(name, sizeof(name), "/fastset-%d-%p-p%d-%d.run", (int)getpid(),
+             (void *)this, partIndex, __sync_fetch_and_add(&m_nextRunId, 1));
+    return m_dir + name;
+  }
 
-      if (m_cocurrent) {
-        m_rwmutex.lock();
+  void mergeLoop() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(m_queueMutex);
+        m_cond.wait(lock, [this] { return m_pending || m_stop; });
+        if (m_stop) {
+          return;
+        }
+        m_pending = false;
       }
-
-      m_enlarging = 0;
-
-      EnlargeStatus s;
-      s.rehashedIndex = -1;
-      s.hashMask = capacity + m_status.hashMask;
-      // 使用原子操作
-      m_status.value = s.value;
-
-      if (m_status.hashMask < ((1 << MAX_CAPACITY_BITS) - 1))
-        m_nextEnlargingSize = HASH_RATIO * (m_status.hashMask + 1);
-
-      if (m_cocurrent) {
-        m_rwmutex.unlock();
+      AutoLock lock(&m_mergeMutex);
+      while (!m_stop && mergeOnce()) {
       }
+    }
+  }
 
-#ifdef DEBUG_VERIFY_AFTER_ENLARGE
-      m_blocking = true;
-      this->debug_verify(m_partIndex);
-      m_blocking = false;
-#endif
+  bool pickRuns(int partIndex, std::vector<RunPtr> &group) const {
+    // 按项数排序，从小到大找 SPILL_MERGE_RUNS 个相邻且大小相差不超过 4 倍
+    // 的 run。分区的内存按块增长，各次写出的 run 大小并不一致
+    std::vector<RunPtr> runs;
+    {
+      AutoLock lock(&m_parts[partIndex].mutex);
+      runs = m_parts[partIndex].runs;
+    }
+    std::sort(runs.begin(), runs.end(), [](const RunPtr &a, const RunPtr &b) {
+      return a->size() < b->size();
+    });
+    for (size_t i = 0; i + SPILL_MERGE_RUNS <= runs.size(); i++) {
+      if (runs[i + SPILL_MERGE_RUNS - 1]->size() <= runs[i]->size() * 4) {
+        group.assign(runs.begin() + i, runs.begin() + i + SPILL_MERGE_RUNS);
+        return true;
+      }
+    }
+    return false;
+  }
 
-    } else if (m_cocurrent) {
-      m_rwmutex.unlock();
+  bool mergeOnce() {
+    // 合并一组 run，没有可合并的（或失败）时返回 false。旧的 run 在 group
+    // 释放时删除
+    for (int i = 0; i < m_partitionCount; i++) {
+      std::vector<RunPtr> group;
+      if (!pickRuns(i, group)) {
+        continue;
+      }
+      RunPtr merged(SpillRun::merge(newPath(i), group));
+      if (!merged) {
+        return false;
+      }
+      AutoLock lock(&m_parts[i].mutex);
+      std::vector<RunPtr> &runs = m_parts[i].runs;
+      for (auto &run : group) {
+        runs.erase(std::find(runs.begin(), runs.end(), run));
+      }
+      runs.push_back(merged);
+      return true;
     }
+    return false;
   }
+};
 
-  void enlargeHashTable(int capacity) {
-    // 扩展hashTable，按当前容量翻倍
-    allocNodeChunk(capacity / m_nodeCountPerChunk);
+// 溢出模式只支持固定大小的数据，其他类型使用空的实现（不会创建）
+template <class T, bool = std::is_arithmetic<T>::value> struct SpillSelector {
+  using type = CSpillStore<T>;
+};
 
-    // 进入第二阶段，高区表已经可用。
-    this->m_enlarging = 2;
+template <class T> struct SpillSelector<T, false> {
+  struct type {
+    size_t size() const { return 0; }
+    int getRunCount() const { return 0; }
+    size_t getPartitionBudget() const { return 0; }
+    bool contains(int, const T &, uint32_t) const { return false; }
+    bool addRun(int, std::vector<std::pair<uint32_t, T>> &) { return false; }
+    void mergeRuns() {}
+    void clear() {}
+    void getMemoryUsage(MemoryUsage &) const {}
+  };
+};
 
-    int dupCount = 0;
-    for (int i = 0; i < capacity; i++) {
-      HashNode *node1 = getNode(i);
-      HashNode *node2 = getNode(capacity + i);
+// 根据 HashNode 选择分区的实现
+template <class T, class HashNode, class Hasher> struct PartitionSelector {
+  using type = PartitionImpl<T, HashNode>;
+};
 
-      node1->lock();
-      node2->lock();
+template <class T, class Stored, class NodeHasher, class Hasher>
+struct PartitionSelector<T, CompactHashNode<T, Stored, NodeHasher>, Hasher> {
+  // CompactHashNode 同样重新计算 hashCode
+  static_assert(std::is_same<NodeHasher, Hasher>::value,
+                "CompactHashNode and FastHashSetImpl must use the same Hasher");
+  using type = PartitionImpl<T, CompactHashNode<T, Stored, NodeHasher>>;
+};
 
-      dupCount += node1->split(this->m_bufMgr, node2, capacity);
-      m_status.rehashedIndex = i;
+template <class T, class NodeHasher, class Hasher>
+struct PartitionSelector<T, SwissHashNode<T, NodeHasher>, Hasher> {
+  // SwissHashNode 不保存 hashCode，重新计算时必须与集合使用同一个策略
+  static_assert(std::is_same<NodeHasher, Hasher>::value,
+                "SwissHashNode and FastHashSetImpl must use the same Hasher");
+  using type = SwissPartitionImpl<T, Hasher>;
+};
 
-      node2->unlock();
-      node1->unlock();
-    }
-  }
+// 节点能否保存 v：只有 CompactHashNode 限制数据的范围
+template <class T, class HashNode> struct NodeRange {
+  static bool fits(const T &v) { return true; }
+};
 
-  void dump(const char *msg) const {
-    LOG_INFO("dump %s, capacity=%d, count=%d\n", msg, m_status.hashMask + 1,
-             m_count);
-    int count = 0;
-    char buf[256] = {0};
-    for (int i = 0; i <= m_status.hashMask; i++) {
-      sprintf(buf, "[%d]: ", i);
-      HashNode *node = getNode(i);
-      node->dump(buf);
-      count += node->getCount();
-    }
-    LOG_INFO("dump finish: %d (expected: %d)\n", count, m_count);
-    assert(count == m_count);
+template <class T, class Stored, class NodeHasher>
+struct NodeRange<T, CompactHashNode<T, Stored, NodeHasher>> {
+  static bool fits(const T &v) {
+    return CompactHashNode<T, Stored, NodeHasher>::fits(v);
   }
 };
 
-template <class T, class HashNode> class FastHashSetImpl {
+template <class T, class HashNode, class Hasher = CalcHash>
+class FastHashSetImpl {
 
-  using FastHashSet = FastHashSetImpl<T, HashNode>;
-  using Partition = PartitionImpl<T, HashNode>;
+  using FastHashSet = FastHashSetImpl<T, HashNode, Hasher>;
+  using Partition = typename PartitionSelector<T, HashNode, Hasher>::type;
+  using SpillStore = typename SpillSelector<T>::type;
 
 public:
   class iterator {
@@ -1254,36 +4412,129 @@ public:
 
 private:
   bool m_cocurrent{false};
+  int m_partitionBits{0};
+  int m_initCapacityBits{0};
   int m_partitionCount{0};
   Partition **m_partitions;
   iterator _end{this, -1, 0, 0};
+  AllocPolicy m_policy;
+
+  unsigned char *m_pMapped{nullptr}; // 映射模式加载的快照
+  int64_t m_mappedSize{0};
+
+  SpillStore *m_spill{nullptr}; // 溢出模式下磁盘上的数据
+  bool m_prefilter{false};       // 分区是否使用 Bloom filter
 
 public:
-  FastHashSetImpl(bool cocurrent, int partitionsBits, int initCapacityBits)
-      : m_cocurrent(cocurrent) {
+  FastHashSetImpl(bool cocurrent, int partitionsBits, int initCapacityBits,
+                  const AllocPolicy &policy = AllocPolicy())
+      : m_cocurrent(cocurrent), m_policy(policy) {
     if (partitionsBits < 0 ) {
       partitionsBits = DEF_PARTITION_BITS;
     } else if(partitionsBits > MAX_PARTITION_BITS) {
       partitionsBits = MAX_PARTITION_BITS;
     }
-    m_partitionCount = 1 << partitionsBits;
-    m_partitions = new Partition *[m_partitionCount];
 
     if (initCapacityBits < MIN_CAPACITY_BITS ||
         initCapacityBits > MAX_CAPACITY_BITS) {
       initCapacityBits = DEF_CAPACITY_BITS;
     }
 
+    initPartitions(partitionsBits, initCapacityBits);
+  }
+
+  FastHashSetImpl(bool cocurrent, ExpectedSize expected,
+                  int partitionsBits = DEF_PARTITION_BITS,
+                  const AllocPolicy &policy = AllocPolicy())
+      : FastHashSetImpl(cocurrent, partitionsBits, DEF_CAPACITY_BITS, policy) {
+    reserve(expected.count);
+  }
+
+  ~FastHashSetImpl() {
+    delete m_spill;
+    releasePartitions();
+  }
+
+  // 按预期的数据个数预先扩容各分区（节点数按 HASH_RATIO 计算），之后的 add
+  // 不再逐次翻倍；空分区直接申请节点块，无需分裂。
+  // 调用时不能有并发的修改，设置内存预算后不起作用
+  void reserve(size_t expectedCount) {
+    if (m_spill != nullptr) {
+      return;
+    }
+    // 各分区的个数近似正态分布，多留 3 个标准差
+    double share = (double)expectedCount / m_partitionCount;
+    int64_t count = (int64_t)(share + 3 * sqrt(share)) + 1;
     for (int i = 0; i < m_partitionCount; i++) {
-      m_partitions[i] = new Partition(m_cocurrent, i, initCapacityBits);
+      getPartition(i)->reserve(count);
     }
   }
 
-  ~FastHashSetImpl() {
+  // 收缩：删除较多之后，把数据较少的分区的节点表减半，节点的扩展内存重新
+  // 紧凑排列（去掉 Slice 数据删除后留下的空洞），空闲的数据块归还给系统。
+  // 按分区进行，可以在后台逐个分区完成（compactPartition），同时只多占用一个
+  // 分区的数据块。链式分区收缩时，该分区不能有并发的读写；开放寻址分区加
+  // 分区锁。快照映射的分区不收缩。返回释放的字节数
+  size_t compactPartition(int partIndex) {
+    return getPartition(partIndex)->compact();
+  }
+
+  size_t compact(int threads = 1) {
+    volatile size_t released = 0;
+    forEachPartition(threads, [this, &released](int i) {
+      __sync_fetch_and_add(&released, getPartition(i)->compact());
+    });
+    return released;
+  }
+
+  // 渐进扩容：每次 add 只分裂少量节点，避免单次 add 完成整个分区的扩容
+  // （降低 add 的尾延迟，总耗时略有增加）。不支持开放寻址分区
+  void setIncrementalRehash(bool incremental) {
     for (int i = 0; i < m_partitionCount; i++) {
-      delete m_partitions[i];
+      getPartition(i)->setIncrementalRehash(incremental);
     }
-    delete[] m_partitions;
+  }
+
+  // 为每个分区维护一个 Bloom filter（每个数据约 10 bit），find/contains 先检查
+  // filter，不存在的数据大多不需要访问节点。适合大部分查询不命中的场景。
+  // 扩容时在分裂节点的同时建立新的 filter，删除较多时重建。开放寻址分区不使用。
+  // 调用时不能有并发的修改
+  void setPrefilter(bool prefilter) {
+    m_prefilter = prefilter;
+    for (int i = 0; i < m_partitionCount; i++) {
+      getPartition(i)->setPrefilter(prefilter);
+    }
+  }
+
+  // 溢出模式：分区占用的内存超过 bytes / 分区数时，把分区的全部数据写成 dir
+  // 下的有序文件（run）并清空分区。之后 add/contains 先查内存，再经各 run 的
+  // Bloom filter 查磁盘，run 由后台线程逐级合并，文件在 clear 或析构时删除。
+  // 只支持线程不安全版本及固定大小的数据。只能看到内存中数据的操作（迭代器、
+  // find、remove、扫描本集合的 addAll 及集合运算）及快照不支持，调用时记录
+  // 错误并返回空的结果。再次调用时只修改预算
+  bool setMemoryBudget(size_t bytes, const char *dir) {
+    static_assert(std::is_arithmetic<T>::value,
+                  "spill mode needs fixed-size values");
+    if (m_cocurrent || bytes == 0 || dir == nullptr) {
+      return false;
+    }
+    if (m_spill != nullptr) {
+      m_spill->setBudget(bytes);
+    } else {
+      m_spill = new SpillStore(dir, bytes, m_partitionCount);
+    }
+    return true;
+  }
+
+  // 同步完成磁盘上 run 的合并（通常由后台线程完成）
+  void mergeSpillRuns() {
+    if (m_spill != nullptr) {
+      m_spill->mergeRuns();
+    }
+  }
+
+  int getSpillRunCount() const {
+    return m_spill != nullptr ? m_spill->getRunCount() : 0;
   }
 
   inline int getPartitionCount() const { return m_partitionCount; }
@@ -1302,9 +4553,8 @@ public:
   }
 
   bool add(const T &v) {
-    uint32_t hashCode = CalcHash::get(v);
-    Partition *p = getPartitionByHashCode(hashCode);
-    return p->add(v, hashCode);
+    uint32_t hashCode = Hasher::get(v);
+    return _add(v, hashCode);
   }
 
   int addAll(iterator begin, iterator end) {
@@ -1318,8 +4568,16 @@ public:
   }
 
   int addAll(FastHashSet *other) {
-    if (this->m_partitionCount == other->getPartitionCount()) {
-      // 两者的分区一致，直接对拷
+    if (other == this) {
+      // 加入自身不改变集合（也不能边扫描边加入）
+      return 0;
+    }
+    if (other->rejectInSpill("addAll")) {
+      return 0;
+    }
+    if (m_spill == nullptr &&
+        this->m_partitionCount == other->getPartitionCount()) {
+      // 两者的分区一致，直接对拷（各分区先按两者中较大者扩容）
       int n = 0;
       for (int i = 0; i < m_partitionCount; i++) {
         Partition *src = other->getPartition(i);
@@ -1327,33 +4585,213 @@ public:
       }
       return n;
     }
-    // 使用重新插入的方式
-    return addAll(other->begin(), other->end());
+    // 分区数不同：按节点中保存的 hashCode 直接定位分区，不重新计算 hash。
+    // hash 均匀分布，各分区先按 other 的平均个数与本分区个数的较大者扩容
+    if (m_spill == nullptr) {
+      int64_t share = other->size() / m_partitionCount + 1;
+      for (int i = 0; i < m_partitionCount; i++) {
+        Partition *p = getPartition(i);
+        p->reserve(std::max((int64_t)p->size(), share));
+      }
+    }
+    int n = 0;
+    other->forEachCode([this, &n](const T &v, uint32_t hashCode) {
+      if (_add(v, hashCode)) {
+        n++;
+      }
+    });
+    return n;
+  }
+
+  size_t addAllParallel(FastHashSet *other, int threads) {
+    // 分区一致时，使用多个线程按分区并行对拷（每个分区一个任务）
+    // 与 addAll 相同，this 和 other 均不存在其他线程的修改
+    if (other == this || m_spill != nullptr ||
+        this->m_partitionCount != other->getPartitionCount()) {
+      return addAll(other);
+    }
+    std::vector<int> counts(m_partitionCount, 0);
+    forEachPartition(threads, [this, other, &counts](int i) {
+      counts[i] = getPartition(i)->addAll(other->getPartition(i));
+    });
+    size_t n = 0;
+    for (int i = 0; i < m_partitionCount; i++) {
+      n += counts[i];
+    }
+    return n;
   }
 
   bool addExclusive(const T &v, const FastHashSet *other) {
     // 如果 v 在 other 中不存在，则加入到this中。否则不加入
     // 只需要计算一次hash
-    uint32_t hashCode = CalcHash::get(v);
-    if (other != nullptr) {
-      int hashIndex = 0;
-      Partition *p = other->getPartitionByHashCode(hashCode);
-      if (p->find(v, hashCode, hashIndex) >= 0) {
-        return false;
+    uint32_t hashCode = Hasher::get(v);
+    if (other != nullptr && other->_contains(v, hashCode)) {
+      return false;
+    }
+    return _add(v, hashCode);
+  }
+
+  // 集合运算：按节点中保存的 hashCode 在另一个集合中查找（不重新计算 hash），
+  // 本集合的节点依次扫描，查找时同一节点的数据落在对方相邻的节点上。
+  // 与 addAll 相同，参与的集合均不存在其他线程的修改。溢出模式的集合只能
+  // 作为被查找的一方（需要扫描或删除时拒绝执行，返回 0）
+
+  // 只保留 other 中也存在的数据，返回删除的个数
+  size_t intersectWith(const FastHashSet *other) {
+    if (rejectInSpill("intersectWith")) {
+      return 0;
+    }
+    return removeIf([other](const T &v, uint32_t hashCode) {
+      return !other->_contains(v, hashCode);
+    });
+  }
+
+  // 删除 other 中也存在的数据，返回删除的个数
+  size_t subtract(const FastHashSet *other) {
+    if (rejectInSpill("subtract")) {
+      return 0;
+    }
+    return removeIf([other](const T &v, uint32_t hashCode) {
+      return other->_contains(v, hashCode);
+    });
+  }
+
+  // 把只在 a 或只在 b 中的数据加入本集合，返回加入的个数。
+  // 本集合为 a（或 b）时原地计算：另一个集合中的数据存在则删除，否则加入
+  size_t symmetricDifference(const FastHashSet *a, const FastHashSet *b) {
+    if (a->rejectInSpill("symmetricDifference") ||
+        b->rejectInSpill("symmetricDifference")) {
+      return 0;
+    }
+    if (this == a || this == b) {
+      const FastHashSet *other = this == a ? b : a;
+      if (other == this) {
+        clear();
+        return 0;
       }
+      size_t n = 0;
+      other->forEachCode([this, &n](const T &v, uint32_t hashCode) {
+        Partition *p = getPartitionByHashCode(hashCode);
+        if (!p->remove(v, hashCode) && _add(v, hashCode)) {
+          n++;
+        }
+      });
+      return n;
     }
-    Partition *p = getPartitionByHashCode(hashCode);
-    return p->add(v, hashCode);
+    size_t n = addDifference(a, b);
+    return n + addDifference(b, a);
+  }
+
+  // 只计数、不生成结果集合的版本
+  size_t intersectionSize(const FastHashSet *other) const {
+    if (rejectInSpill("intersectionSize")) {
+      return 0;
+    }
+    size_t n = 0;
+    forEachCode([other, &n](const T &v, uint32_t hashCode) {
+      n += other->_contains(v, hashCode) ? 1 : 0;
+    });
+    return n;
+  }
+
+  // 本集合中不在 other 中的个数
+  size_t differenceSize(const FastHashSet *other) const {
+    if (rejectInSpill("differenceSize")) {
+      return 0;
+    }
+    size_t n = 0;
+    forEachCode([other, &n](const T &v, uint32_t hashCode) {
+      n += other->_contains(v, hashCode) ? 0 : 1;
+    });
+    return n;
+  }
+
+  size_t symmetricDifferenceSize(const FastHashSet *other) const {
+    if (rejectInSpill("symmetricDifferenceSize") ||
+        other->rejectInSpill("symmetricDifferenceSize")) {
+      return 0;
+    }
+    return differenceSize(other) + other->differenceSize(this);
   }
 
   bool contains(const T &v) const {
-    uint32_t hashCode = CalcHash::get(v);
-    iterator it = _find(v, hashCode);
-    return it != _end;
+    uint32_t hashCode = Hasher::get(v);
+    return _contains(v, hashCode);
+  }
+
+  size_t addBatch(const T *keys, size_t n, bool *results = nullptr) {
+    // 批量加入，提前 PREFETCH_WINDOW 个计算 hash 并预取节点，使得 cache miss
+    // 可以重叠。results 可为空，返回成功加入的个数
+    uint32_t codes[PREFETCH_WINDOW];
+    size_t count = 0;
+    for (size_t i = 0; i < n && i < PREFETCH_WINDOW; i++) {
+      codes[i] = prefetch(keys[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint32_t hashCode = codes[i % PREFETCH_WINDOW];
+      if (i + PREFETCH_WINDOW < n) {
+        codes[i % PREFETCH_WINDOW] = prefetch(keys[i + PREFETCH_WINDOW]);
+      }
+      bool ret = _add(keys[i], hashCode);
+      if (results != nullptr) {
+        results[i] = ret;
+      }
+      count += ret ? 1 : 0;
+    }
+    return count;
+  }
+
+  size_t containsBatch(const T *keys, size_t n, bool *results = nullptr) const {
+    // 批量检查，方式同 addBatch。results 可为空，返回存在的个数
+    uint32_t codes[PREFETCH_WINDOW];
+    size_t count = 0;
+    for (size_t i = 0; i < n && i < PREFETCH_WINDOW; i++) {
+      codes[i] = prefetch(keys[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint32_t hashCode = codes[i % PREFETCH_WINDOW];
+      if (i + PREFETCH_WINDOW < n) {
+        codes[i % PREFETCH_WINDOW] = prefetch(keys[i + PREFETCH_WINDOW]);
+      }
+      bool ret = _contains(keys[i], hashCode);
+      if (results != nullptr) {
+        results[i] = ret;
+      }
+      count += ret ? 1 : 0;
+    }
+    return count;
+  }
+
+  size_t removeBatch(const T *keys, size_t n, bool *results = nullptr) {
+    // 批量删除，方式同 addBatch。线程安全版本中可与 add、remove 及查找并发。
+    // results 可为空，返回成功删除的个数
+    if (rejectInSpill("removeBatch")) {
+      return 0;
+    }
+    uint32_t codes[PREFETCH_WINDOW];
+    size_t count = 0;
+    for (size_t i = 0; i < n && i < PREFETCH_WINDOW; i++) {
+      codes[i] = prefetch(keys[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      uint32_t hashCode = codes[i % PREFETCH_WINDOW];
+      if (i + PREFETCH_WINDOW < n) {
+        codes[i % PREFETCH_WINDOW] = prefetch(keys[i + PREFETCH_WINDOW]);
+      }
+      bool ret = getPartitionByHashCode(hashCode)->remove(keys[i], hashCode);
+      if (results != nullptr) {
+        results[i] = ret;
+      }
+      count += ret ? 1 : 0;
+    }
+    return count;
   }
 
   bool remove(const T &v) {
-    uint32_t hashCode = CalcHash::get(v);
+    if (rejectInSpill("remove")) {
+      return false;
+    }
+    uint32_t hashCode = Hasher::get(v);
     Partition *p = getPartitionByHashCode(hashCode);
     return p->remove(v, hashCode);
   }
@@ -1376,54 +4814,232 @@ public:
   }
 
   size_t size() const {
-    int count = 0;
+    size_t count = 0;
     for (int i = 0; i < m_partitionCount; i++) {
       count += getPartition(i)->size();
     }
-    return count;
+    return count + (m_spill != nullptr ? m_spill->size() : 0);
   }
 
   void clear() {
 #ifdef _DUMP_STAT_BEFORE_CLEAR
     dump_stat();
 #endif
+    if (m_spill != nullptr) {
+      m_spill->clear();
+    }
     for (int i = 0; i < m_partitionCount; i++) {
       getPartition(i)->clear();
     }
   }
 
+  void clearParallel(int threads) {
+#ifdef _DUMP_STAT_BEFORE_CLEAR
+    dump_stat();
+#endif
+    if (m_spill != nullptr) {
+      m_spill->clear();
+    }
+    forEachPartition(threads, [this](int i) { getPartition(i)->clear(); });
+  }
+
+  template <class F> void forEachPartition(int threads, F fn) const {
+    // 使用 threads 个线程（包括调用线程），对每个分区调用 fn(partIndex)。
+    // 线程创建失败时由已经创建的线程完成；fn 抛出异常时不再领取分区，
+    // 全部线程结束后重新抛出第一个异常
+    if (threads > m_partitionCount) {
+      threads = m_partitionCount;
+    }
+    if (threads <= 1) {
+      for (int i = 0; i < m_partitionCount; i++) {
+        fn(i);
+      }
+      return;
+    }
+    volatile int next = 0;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto work = [this, &next, &fn, &errorMutex, &error] {
+      int i = 0;
+      while ((i = __sync_fetch_and_add(&next, 1)) < m_partitionCount) {
+        try {
+          fn(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+          next = m_partitionCount;
+          return;
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    try {
+      workers.reserve(threads - 1);
+      for (int t = 1; t < threads; t++) {
+        workers.emplace_back(work);
+      }
+    } catch (...) {
+      LOG_ERROR("create worker thread failed, %d of %d started\n",
+                (int)workers.size(), threads - 1);
+    }
+    work();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
   void debug_verify() const {
-    int count = 0;
-    int total = 0;
-    int sum_count = 0;
-    int sum_total = 0;
+    int64_t count = 0;
+    int64_t total = 0;
+    int64_t sum_count = 0;
+    int64_t sum_total = 0;
     for (int i = 0; i < m_partitionCount; i++) {
       count = getPartition(i)->size();
       total = getPartition(i)->debug_verify(i);
       if (count != total) {
         char buf[256]{0};
-        sprintf(buf, "partition[%d]: incorrect size: %d, actual: %d ", i, count,
-                total);
+        sprintf(buf, "partition[%d]: incorrect size: %ld, actual: %ld ", i,
+                count, total);
         getPartition(i)->dump_stat(buf);
       }
       sum_count += count;
       sum_total += total;
     }
     if (sum_total != sum_count) {
-      LOG_INFO("incorrect size: %d, actual: %d\n", sum_count, sum_total);
+      LOG_INFO("incorrect size: %ld, actual: %ld\n", sum_count, sum_total);
     }
   }
 
+  // 各分区的内存占用（快照映射的内存不属于任何分区）
+  void memoryUsage(std::vector<MemoryUsage> &parts) const {
+    parts.assign(m_partitionCount, MemoryUsage());
+    for (int i = 0; i < m_partitionCount; i++) {
+      getPartition(i)->getMemoryUsage(parts[i]);
+    }
+  }
+
+  // 整个集合的内存占用，可与 add 并发调用
+  MemoryUsage memoryUsage() const {
+    MemoryUsage usage;
+    for (int i = 0; i < m_partitionCount; i++) {
+      getPartition(i)->getMemoryUsage(usage);
+    }
+    usage.overhead += sizeof(*this) + sizeof(Partition *) * m_partitionCount;
+    usage.mapped += m_mappedSize;
+    if (m_spill != nullptr) {
+      m_spill->getMemoryUsage(usage);
+    }
+    return usage;
+  }
+
   void dump_stat() const {
     char buf[128];
     for (int i = 0; i < m_partitionCount; i++) {
       sprintf(buf, "partition_%d ", i);
       getPartition(i)->dump_stat(buf);
     }
+    MemoryUsage usage = memoryUsage();
+    LOG_INFO("memory: total=%ld, nodes=%ld, chunks=%ld, free=%ld, wasted=%ld, "
+             "overhead=%ld, mapped=%ld\n",
+             (long)usage.total(), (long)usage.nodeTable, (long)usage.dataChunks,
+             (long)usage.freeLists, (long)usage.wastedTail,
+             (long)usage.overhead, (long)usage.mapped);
+  }
+
+  bool saveTo(const char *path) const {
+    // 保存快照，不支持与修改操作并发
+    if (m_spill != nullptr) {
+      LOG_ERROR("snapshot is not supported in spill mode\n");
+      return false;
+    }
+    CSnapshotFile file;
+    if (!file.create(path)) {
+      LOG_ERROR("create snapshot failed: %s\n", path);
+      return false;
+    }
+    SnapshotHeader header;
+    initSnapshotHeader(header);
+    header.partitionBits = m_partitionBits;
+    header.initCapacityBits = m_initCapacityBits;
+    std::vector<SnapshotPartition> parts(m_partitionCount);
+    int64_t partsSize = sizeof(SnapshotPartition) * m_partitionCount;
+
+    bool ok = file.write(&header, sizeof(header)) &&
+              file.write(parts.data(), partsSize);
+    for (int i = 0; ok && i < m_partitionCount; i++) {
+      // 快照中不保存渐进扩容的中间状态
+      getPartition(i)->finishRehash();
+      ok = getPartition(i)->save(file, parts[i]);
+    }
+    // 回写各分区的位置
+    ok = ok && file.seek(sizeof(header), SEEK_SET) &&
+         file.write(parts.data(), partsSize);
+    if (!ok) {
+      LOG_ERROR("write snapshot failed: %s\n", path);
+    }
+    return ok;
+  }
+
+  bool loadFrom(const char *path, bool useMmap = false) {
+    // 加载快照，替换当前的全部数据（分区数等使用快照中的值），不支持并发。
+    // useMmap 时直接使用文件映射的内存（MAP_PRIVATE），无需重新计算 hash，
+    // 映射在析构或再次加载时释放
+    if (m_spill != nullptr) {
+      LOG_ERROR("snapshot is not supported in spill mode\n");
+      return false;
+    }
+    CSnapshotFile file;
+    SnapshotHeader header;
+    SnapshotHeader expected;
+    initSnapshotHeader(expected);
+    if (!file.open(path, useMmap) || !file.read(0, &header, sizeof(header)) ||
+        memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version ||
+        header.nodeSize != expected.nodeSize ||
+        header.valueSize != expected.valueSize ||
+        header.hashId != expected.hashId ||
+        header.partitionBits < 0 || header.partitionBits > MAX_PARTITION_BITS ||
+        header.initCapacityBits < MIN_CAPACITY_BITS ||
+        header.initCapacityBits > MAX_CAPACITY_BITS) {
+      LOG_ERROR("invalid snapshot: %s\n", path);
+      return false;
+    }
+    std::vector<SnapshotPartition> parts(1 << header.partitionBits);
+    if (!file.read(sizeof(header), parts.data(),
+                   sizeof(SnapshotPartition) * parts.size())) {
+      LOG_ERROR("invalid snapshot: %s\n", path);
+      return false;
+    }
+
+    releasePartitions();
+    initPartitions(header.partitionBits, header.initCapacityBits);
+    bool ok = true;
+    for (int i = 0; ok && i < m_partitionCount; i++) {
+      ok = getPartition(i)->load(file, parts[i]);
+    }
+    for (int i = 0; ok && m_prefilter && i < m_partitionCount; i++) {
+      getPartition(i)->setPrefilter(true);
+    }
+    if (file.isMapped()) {
+      m_pMapped = file.detachMapping(m_mappedSize);
+    }
+    if (!ok) {
+      LOG_ERROR("load snapshot failed: %s\n", path);
+      clear();
+    }
+    return ok;
   }
 
 public: // for iterator
   iterator begin() const {
+    if (rejectInSpill("iterator")) {
+      return end();
+    }
     iterator it{this, 0, 0, -1};
     return ++it;
   }
@@ -1431,7 +5047,10 @@ public: // for iterator
   const iterator &end() const { return this->_end; }
 
   iterator find(const T &v) const {
-    uint32_t hashCode = CalcHash::get(v);
+    if (rejectInSpill("find")) {
+      return end();
+    }
+    uint32_t hashCode = Hasher::get(v);
     return _find(v, hashCode);
   }
 
@@ -1440,6 +5059,155 @@ public: // for iterator
   }
 
 private:
+  void initPartitions(int partitionsBits, int initCapacityBits) {
+    m_partitionBits = partitionsBits;
+    m_initCapacityBits = initCapacityBits;
+    m_partitionCount = 1 << partitionsBits;
+    m_partitions = new Partition *[m_partitionCount];
+    for (int i = 0; i < m_partitionCount; i++) {
+      m_partitions[i] =
+          new Partition(m_cocurrent, i, initCapacityBits, m_policy);
+    }
+  }
+
+  void releasePartitions() {
+    // 析构时串行释放，不创建线程；需要并行释放时先调用 clearParallel
+    for (int i = 0; i < m_partitionCount; i++) {
+      delete m_partitions[i];
+    }
+    delete[] m_partitions;
+    m_partitions = nullptr;
+    CSnapshotFile::unmap(m_pMapped, m_mappedSize);
+    m_pMapped = nullptr;
+  }
+
+  // 溢出模式下拒绝只能看到内存中数据的操作，记录错误
+  bool rejectInSpill(const char *op) const {
+    if (m_spill == nullptr) {
+      return false;
+    }
+    LOG_ERROR("%s is not supported in spill mode\n", op);
+    return true;
+  }
+
+  static void initSnapshotHeader(SnapshotHeader &header) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FASTSET", 8);
+    header.version = SNAPSHOT_VERSION;
+    header.nodeSize = sizeof(HashNode);
+    header.valueSize = sizeof(T);
+    header.hashId = Hasher::ID;
+  }
+
+  uint32_t prefetch(const T &v) const {
+    uint32_t hashCode = Hasher::get(v);
+    getPartitionByHashCode(hashCode)->prefetch(hashCode);
+    return hashCode;
+  }
+
+  bool _add(const T &v, uint32_t hashCode) {
+    if (!NodeRange<T, HashNode>::fits(v)) {
+      // 不能静默丢弃（add 返回 false 表示已经存在）。在加节点锁之前检查
+      LOG_ERROR("value out of the node's range\n");
+      throw std::out_of_range("value out of the node's range");
+    }
+    Partition *p = getPartitionByHashCode(hashCode);
+    if (m_spill == nullptr) {
+      return p->add(v, hashCode);
+    }
+    return spillAdd(p, v, hashCode);
+  }
+
+  bool _contains(const T &v, uint32_t hashCode) const {
+    int partIndex = getPartitionIndex(hashCode);
+    int hashIndex = 0;
+    if (getPartition(partIndex)->find(v, hashCode, hashIndex) >= 0) {
+      return true;
+    }
+    return m_spill != nullptr && m_spill->contains(partIndex, v, hashCode);
+  }
+
+  // 依次对内存中的每一项调用 fn(v, hashCode)，hashCode 取自节点
+  template <class F> void forEachCode(F fn) const {
+    for (int i = 0; i < m_partitionCount; i++) {
+      Partition *p = getPartition(i);
+      for (int j = 0; j <= p->getMask(); j++) {
+        HashNode *node = p->getNode(j);
+        for (int k = 0; k < node->getCount(); k++) {
+          fn(node->getValue(k), node->getCode(k));
+        }
+      }
+    }
+  }
+
+  // 删除 fn(v, hashCode) 返回 true 的项。删除时节点的最后一项移到当前位置
+  // （remove 不迁移节点），因此删除后不前进
+  template <class F> size_t removeIf(F fn) {
+    size_t n = 0;
+    for (int i = 0; i < m_partitionCount; i++) {
+      Partition *p = getPartition(i);
+      for (int j = 0; j <= p->getMask(); j++) {
+        HashNode *node = p->getNode(j);
+        for (int k = 0; k < node->getCount();) {
+          T v = node->getValue(k);
+          uint32_t hashCode = node->getCode(k);
+          if (fn(v, hashCode) && p->remove(v, hashCode)) {
+            n++;
+          } else {
+            k++;
+          }
+        }
+      }
+    }
+    return n;
+  }
+
+  // 把 a 中不在 b 中的数据加入本集合，返回加入的个数
+  size_t addDifference(const FastHashSet *a, const FastHashSet *b) {
+    size_t n = 0;
+    a->forEachCode([this, b, &n](const T &v, uint32_t hashCode) {
+      if (!b->_contains(v, hashCode) && _add(v, hashCode)) {
+        n++;
+      }
+    });
+    return n;
+  }
+
+  bool spillAdd(Partition *p, const T &v, uint32_t hashCode) {
+    // 内存及磁盘上都没有时才加入，之后按间隔检查分区的内存预算
+    int partIndex = getPartitionIndex(hashCode);
+    int hashIndex = 0;
+    if (p->find(v, hashCode, hashIndex) >= 0 ||
+        m_spill->contains(partIndex, v, hashCode) || !p->add(v, hashCode)) {
+      return false;
+    }
+    if ((p->size() & (SPILL_CHECK_INTERVAL - 1)) == 0) {
+      MemoryUsage usage;
+      p->getMemoryUsage(usage);
+      if (usage.total() > m_spill->getPartitionBudget()) {
+        spillPartition(partIndex);
+      }
+    }
+    return true;
+  }
+
+  void spillPartition(int partIndex) {
+    // 把分区的全部数据写成一个 run 并清空分区，写入失败时仍保留在内存中
+    Partition *p = getPartition(partIndex);
+    std::vector<std::pair<uint32_t, T>> items;
+    items.reserve(p->size());
+    for (int i = 0; i <= p->getMask(); i++) {
+      HashNode *node = p->getNode(i);
+      for (int k = 0; k < node->getCount(); k++) {
+        T v = node->getValue(k);
+        items.push_back(std::make_pair(Hasher::get(v), v));
+      }
+    }
+    if (m_spill->addRun(partIndex, items)) {
+      p->clear();
+    }
+  }
+
   iterator _find(const T &v, uint32_t hashCode) const {
     int partIndex = getPartitionIndex(hashCode);
     int hashIndex = 0;
@@ -1452,14 +5220,24 @@ private:
   }
 };
 
-template <class T>
-class CSimpleHashSet : public FastHashSetImpl<T, FixedSizeHashNode<T>> {
-  using FastHashSet = FastHashSetImpl<T, FixedSizeHashNode<T>>;
+// HashNode 为 FixedSizeHashNode<T>/CompactHashNode<T, Stored> 时使用链式分区，
+// 为 SwissHashNode<T> 时使用开放寻址分区（此时 SwissHashNode、CompactHashNode
+// 的 Hasher 需与 Hasher 相同）
+template <class T, class HashNode = FixedSizeHashNode<T>,
+          class Hasher = CalcHash>
+class CSimpleHashSet : public FastHashSetImpl<T, HashNode, Hasher> {
+  using FastHashSet = FastHashSetImpl<T, HashNode, Hasher>;
 
 public:
   CSimpleHashSet(bool cocurrent, int partitionBits = DEF_PARTITION_BITS,
-                 int capacityBits = DEF_CAPACITY_BITS)
-      : FastHashSet(cocurrent, partitionBits, capacityBits) {}
+                 int capacityBits = DEF_CAPACITY_BITS,
+                 const AllocPolicy &policy = AllocPolicy())
+      : FastHashSet(cocurrent, partitionBits, capacityBits, policy) {}
+
+  CSimpleHashSet(bool cocurrent, ExpectedSize expected,
+                 int partitionBits = DEF_PARTITION_BITS,
+                 const AllocPolicy &policy = AllocPolicy())
+      : FastHashSet(cocurrent, expected, partitionBits, policy) {}
 };
 
 class CSliceHashSet : public FastHashSetImpl<Slice, SliceHashNode> {
@@ -1467,8 +5245,14 @@ class CSliceHashSet : public FastHashSetImpl<Slice, SliceHashNode> {
 
 public:
   CSliceHashSet(bool cocurrent, int partitionBits = DEF_PARTITION_BITS,
-                int capacityBits = DEF_CAPACITY_BITS)
-      : FastHashSet(cocurrent, partitionBits, capacityBits) {}
+                int capacityBits = DEF_CAPACITY_BITS,
+                const AllocPolicy &policy = AllocPolicy())
+      : FastHashSet(cocurrent, partitionBits, capacityBits, policy) {}
+
+  CSliceHashSet(bool cocurrent, ExpectedSize expected,
+                int partitionBits = DEF_PARTITION_BITS,
+                const AllocPolicy &policy = AllocPolicy())
+      : FastHashSet(cocurrent, expected, partitionBits, policy) {}
 };
 
 } // namespace fastset
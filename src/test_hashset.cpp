@@ -1,11 +1,18 @@
 
 #include "fasthashset.h"
+#include <algorithm>
 #include <sys/time.h>
 #include <thread>
 #include <unistd.h>
 #include <unordered_set>
 
 using LongHashset = fastset::CSimpleHashSet<uint64_t>;
+using SwissLongHashset =
+    fastset::CSimpleHashSet<uint64_t, fastset::SwissHashNode<uint64_t>>;
+// id 不超过 32 位时，按 uint32_t 保存且不保存 hashCode
+using CompactLongHashset =
+    fastset::CSimpleHashSet<uint64_t,
+                            fastset::CompactHashNode<uint64_t, uint32_t>>;
 using SliceHashset = fastset::CSliceHashSet;
 using Slice = fastset::Slice;
 using CalcHash = fastset::CalcHash;
@@ -43,6 +50,42 @@ long getTickCount() {
   return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
+long getTickNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+long getRssKB() {
+  // 当前进程的常驻内存（linux）
+  long pages = 0;
+  FILE *pFile = fopen("/proc/self/statm", "rt");
+  if (pFile != nullptr) {
+    if (fscanf(pFile, "%*s %ld", &pages) != 1) {
+      pages = 0;
+    }
+    fclose(pFile);
+  }
+  return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+long getAnonHugeKB() {
+  // 当前进程使用的透明大页（linux）
+  long total = 0;
+  FILE *pFile = fopen("/proc/self/smaps_rollup", "rt");
+  if (pFile != nullptr) {
+    char buf[256];
+    while (fgets(buf, sizeof(buf), pFile)) {
+      long kb = 0;
+      if (sscanf(buf, "AnonHugePages: %ld kB", &kb) == 1) {
+        total += kb;
+      }
+    }
+    fclose(pFile);
+  }
+  return total;
+}
+
 template <class T, class ValueT> class TestHashset {
 
   struct WorkerItem {
@@ -59,6 +102,9 @@ template <class T, class ValueT> class TestHashset {
 
   std::string m_name;
 
+  // 行为测试使用的数据：与加载的数据无关，第 i 个值互不相同
+  std::vector<uint64_t> m_keys;
+
 public:
   TestHashset(const char *name)
       : m_name(name){
@@ -145,9 +191,24 @@ public:
 
   uint64_t checkSum(uint64_t t) { return t; }
 
+  void initKeys(int n) {
+    // 不超过 32 位，紧凑节点也可以保存
+    m_keys.resize(n);
+    for (int i = 0; i < n; i++) {
+      m_keys[i] = (uint64_t)i * 7 + 1;
+    }
+  }
+
+  uint64_t makeKey(uint64_t dummy, int i) { return m_keys[i]; }
+
+  Slice makeKey(const Slice &dummy, int i) {
+    return Slice{sizeof(uint64_t), (unsigned char *)&m_keys[i]};
+  }
+
   void prof_hashset(const char *name, bool cocurrent) {
     printf("==== test %s%s...\n", m_name.c_str(), name);
 
+    long rss = getRssKB();
     T s(cocurrent);
     T s1(cocurrent);
 
@@ -158,6 +219,7 @@ public:
 
     printf("%s add %d, %ld, cost: %ld\n", name, MAX_COUNT, s.size(),
            (getTickCount() - start));
+    printf("%s memory: %ld KB\n", name, getRssKB() - rss);
 
     // s.dump_stat();
 
@@ -214,6 +276,471 @@ public:
     printf("%s clear2 cost: %ld\n", name, (getTickCount() - start));
   }
 
+  void prof_node_probe() {
+    // 比较 node 内逐个比较数据与先比较 hashCode（SIMD）的查找性能
+    printf("==== test %s node probe...\n", m_name.c_str());
+
+    T s(false);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+
+    time_t start = getTickCount();
+    long c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      ValueT v = makeValue(_dummy, i);
+      uint32_t hashCode = CalcHash::get(v);
+      auto p = s.getPartition(s.getPartitionIndex(hashCode));
+      auto node = p->getNode(hashCode & p->getMask());
+      c += node->find(v) >= 0 ? 1 : 0;
+    }
+    printf("find by value %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+
+    start = getTickCount();
+    c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      ValueT v = makeValue(_dummy, i);
+      uint32_t hashCode = CalcHash::get(v);
+      auto p = s.getPartition(s.getPartitionIndex(hashCode));
+      auto node = p->getNode(hashCode & p->getMask());
+      c += node->find(v, hashCode) >= 0 ? 1 : 0;
+    }
+    printf("find by hashCode %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+  }
+
+  void prof_batch(bool cocurrent) {
+    // 比较逐个处理与批量（预取）处理的性能
+    printf("==== test %s batch...\n", m_name.c_str());
+    const int BATCH = 4096;
+    ValueT *keys = new ValueT[BATCH];
+    bool *results = new bool[BATCH];
+
+    T s(cocurrent);
+    time_t start = getTickCount();
+    long c = 0;
+    for (int i = 0; i < MAX_COUNT; i += BATCH) {
+      int n = MAX_COUNT - i < BATCH ? MAX_COUNT - i : BATCH;
+      for (int j = 0; j < n; j++) {
+        keys[j] = makeValue(_dummy, i + j);
+      }
+      c += s.addBatch(keys, n, results);
+    }
+    printf("addBatch %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+
+    start = getTickCount();
+    c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      c += s.contains(makeValue(_dummy, i)) ? 1 : 0;
+    }
+    printf("contains %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+
+    start = getTickCount();
+    c = 0;
+    for (int i = 0; i < MAX_COUNT; i += BATCH) {
+      int n = MAX_COUNT - i < BATCH ? MAX_COUNT - i : BATCH;
+      for (int j = 0; j < n; j++) {
+        keys[j] = makeValue(_dummy, i + j);
+      }
+      c += s.containsBatch(keys, n, results);
+    }
+    printf("containsBatch %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+
+    // 下标为偶数的逐个删除，奇数的批量删除
+    start = getTickCount();
+    c = 0;
+    for (int i = 0; i < MAX_COUNT; i += 2) {
+      c += s.remove(makeValue(_dummy, i)) ? 1 : 0;
+    }
+    printf("remove %d, %ld, cost: %ld\n", MAX_COUNT / 2, c,
+           (getTickCount() - start));
+
+    start = getTickCount();
+    c = 0;
+    for (int i = 1; i < MAX_COUNT; i += BATCH * 2) {
+      int n = 0;
+      for (int j = i; j < MAX_COUNT && n < BATCH; j += 2) {
+        keys[n++] = makeValue(_dummy, j);
+      }
+      c += s.removeBatch(keys, n, results);
+    }
+    printf("removeBatch %d, %ld, cost: %ld\n", MAX_COUNT / 2, c,
+           (getTickCount() - start));
+
+    delete[] keys;
+    delete[] results;
+  }
+
+  void prof_add_latency(bool incremental) {
+    // 单次 add 的延迟分布，比较一次扩容与渐进扩容（incremental）
+    printf("==== test %s add latency (incremental=%d)...\n", m_name.c_str(),
+           incremental);
+    const int n = MAX_COUNT < (1 << 24) ? MAX_COUNT : (1 << 24);
+    std::vector<uint32_t> costs(n);
+
+    T s(false);
+    s.setIncrementalRehash(incremental);
+    time_t start = getTickCount();
+    for (int i = 0; i < n; i++) {
+      ValueT v = makeValue(_dummy, i);
+      long t0 = getTickNs();
+      s.add(v);
+      costs[i] = (uint32_t)(getTickNs() - t0);
+    }
+    printf("add %d, %ld, cost: %ld\n", n, s.size(), (getTickCount() - start));
+
+    std::sort(costs.begin(), costs.end());
+    printf("latency(ns): p50=%u, p99=%u, p999=%u, p9999=%u, max=%u\n",
+           costs[n / 2], costs[n / 100 * 99], costs[n / 1000 * 999],
+           costs[n / 10000 * 9999], costs[n - 1]);
+  }
+
+  void prof_cocurrent_enlarge(int threads) {
+    // 多线程 add 时扩容的停顿：统计各线程单次 add 的最大延迟
+    printf("==== test %s cocurrent enlarge (threads=%d)...\n", m_name.c_str(),
+           threads);
+    T s(true);
+    std::vector<long> maxCost(threads, 0);
+    std::vector<std::thread> workers;
+    time_t start = getTickCount();
+    for (int t = 0; t < threads; t++) {
+      workers.emplace_back([this, &s, &maxCost, t, threads]() {
+        for (int i = t; i < MAX_COUNT; i += threads) {
+          ValueT v = makeValue(_dummy, i);
+          long t0 = getTickNs();
+          s.add(v);
+          long cost = getTickNs() - t0;
+          if (cost > maxCost[t]) {
+            maxCost[t] = cost;
+          }
+        }
+      });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+    std::sort(maxCost.begin(), maxCost.end());
+    printf("add %d, %ld, cost: %ld, max latency(us): median=%ld, max=%ld\n",
+           MAX_COUNT, s.size(), (getTickCount() - start),
+           maxCost[threads / 2] / 1000, maxCost[threads - 1] / 1000);
+  }
+
+  void prof_read_write(int readers, int writers) {
+    // 读写混合：writers 个线程加入后一半数据（节点扩容、分区扩容），同时
+    // readers 个线程查找已经加入的前一半数据，不应有查不到的
+    printf("==== test %s read/write (readers=%d, writers=%d)...\n",
+           m_name.c_str(), readers, writers);
+    T s(true);
+    int half = MAX_COUNT / 2;
+    for (int i = 0; i < half; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    std::vector<long> missed(readers, 0);
+    std::vector<std::thread> workers;
+    time_t start = getTickCount();
+    for (int t = 0; t < writers; t++) {
+      workers.emplace_back([this, &s, t, half, writers]() {
+        for (int i = half + t; i < MAX_COUNT; i += writers) {
+          s.add(makeValue(_dummy, i));
+        }
+      });
+    }
+    for (int t = 0; t < readers; t++) {
+      workers.emplace_back([this, &s, &missed, t, half]() {
+        for (int i = t; i < half * 2; i++) {
+          missed[t] += s.contains(makeValue(_dummy, i % half)) ? 0 : 1;
+        }
+      });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+    long total = 0;
+    for (long m : missed) {
+      total += m;
+    }
+    printf("add %d, contains %ld, %ld, missed: %ld, cost: %ld\n",
+           MAX_COUNT - half, (long)half * 2 * readers, s.size(), total,
+           (getTickCount() - start));
+  }
+
+  void prof_alloc_policy(const char *name, const fastset::AllocPolicy &policy) {
+    // 比较内存申请策略（大页、NUMA）对 add/contains 的影响
+    printf("==== test %s alloc policy %s...\n", m_name.c_str(), name);
+    long hugeKB = getAnonHugeKB();
+    T s(false, fastset::DEF_PARTITION_BITS, fastset::DEF_CAPACITY_BITS,
+        policy);
+    time_t start = getTickCount();
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    printf("add %d, %ld, cost: %ld\n", MAX_COUNT, s.size(),
+           (getTickCount() - start));
+
+    start = getTickCount();
+    long c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      c += s.contains(makeValue(_dummy, i * 7)) ? 1 : 0;
+    }
+    printf("contains %d, %ld, cost: %ld, huge pages: %ld KB\n", MAX_COUNT, c,
+           (getTickCount() - start), getAnonHugeKB() - hugeKB);
+  }
+
+  void prof_memory_usage(int partitionBits, int capacityBits) {
+    // memoryUsage() 与进程常驻内存的增量对比，及各分区的占用
+    printf("==== test %s memory usage (partitionBits=%d, capacityBits=%d)...\n",
+           m_name.c_str(), partitionBits, capacityBits);
+    long rss = getRssKB();
+    T s(false, partitionBits, capacityBits);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    fastset::MemoryUsage usage = s.memoryUsage();
+    printf("size %ld, memoryUsage %ld KB (nodes=%ld, chunks=%ld, free=%ld, "
+           "wasted=%ld, overhead=%ld), rss %ld KB\n",
+           s.size(), (long)usage.total() / 1024, (long)usage.nodeTable / 1024,
+           (long)usage.dataChunks / 1024, (long)usage.freeLists / 1024,
+           (long)usage.wastedTail / 1024, (long)usage.overhead / 1024,
+           getRssKB() - rss);
+
+    std::vector<fastset::MemoryUsage> parts;
+    s.memoryUsage(parts);
+    for (size_t i = 0; i < parts.size() && i < 4; i++) {
+      printf("partition_%ld: %ld KB\n", (long)i, (long)parts[i].total() / 1024);
+    }
+  }
+
+  void prof_spill(size_t budgetMB, const char *dir) {
+    // 溢出模式：内存预算为 budgetMB 时的 add/contains，与不限内存对比
+    printf("==== test %s spill (budget=%ldMB, dir=%s)...\n", m_name.c_str(),
+           (long)budgetMB, dir);
+    T s(false);
+    if (budgetMB > 0 && !s.setMemoryBudget(budgetMB << 20, dir)) {
+      printf("spill mode is not supported\n");
+      return;
+    }
+    time_t start = getTickCount();
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    printf("add %d, %ld, cost: %ld, runs: %d\n", MAX_COUNT, s.size(),
+           (getTickCount() - start), s.getSpillRunCount());
+
+    start = getTickCount();
+    s.mergeSpillRuns();
+    fastset::MemoryUsage usage = s.memoryUsage();
+    printf("merge cost: %ld, runs: %d, memory: %ld KB, mapped: %ld KB\n",
+           (getTickCount() - start), s.getSpillRunCount(),
+           (long)(usage.total() - usage.mapped) / 1024,
+           (long)usage.mapped / 1024);
+
+    // 一半存在，一半不存在
+    start = getTickCount();
+    long c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      c += s.contains(makeValue(_dummy, i * 2)) ? 1 : 0;
+    }
+    printf("contains %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+  }
+
+  void prof_prefilter(bool cocurrent, bool prefilter) {
+    // 大部分查询不命中（90%）时，分区 Bloom filter 对 contains 的影响
+    printf("==== test %s prefilter (cocurrent=%d, prefilter=%d)...\n",
+           m_name.c_str(), cocurrent, prefilter);
+    T s(cocurrent);
+    s.setPrefilter(prefilter);
+    int count = MAX_COUNT / 2;
+    time_t start = getTickCount();
+    for (int i = 0; i < count; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    fastset::MemoryUsage usage = s.memoryUsage();
+    printf("add %d, %ld, cost: %ld, overhead: %ld KB\n", count, s.size(),
+           (getTickCount() - start), (long)usage.overhead / 1024);
+
+    // 每 10 个查询中 1 个在 [0, count)，其余在 [count, MAX_COUNT)
+    start = getTickCount();
+    long c = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+      int k = i % 10 == 0 ? i % count : count + i % count;
+      c += s.contains(makeValue(_dummy, k)) ? 1 : 0;
+    }
+    printf("contains %d, %ld, cost: %ld\n", MAX_COUNT, c,
+           (getTickCount() - start));
+  }
+
+  void prof_set_algebra(int partitionBits) {
+    // 集合运算与逐个 contains 比较：a 为 [0, count)，b 为 [count/2, count*3/2)
+    printf("==== test %s set algebra (partitionBits=%d)...\n", m_name.c_str(),
+           partitionBits);
+    int count = MAX_COUNT / 2;
+    T a(false), b(false, partitionBits);
+    for (int i = 0; i < count; i++) {
+      a.add(makeValue(_dummy, i));
+      b.add(makeValue(_dummy, i + count / 2));
+    }
+
+    time_t start = getTickCount();
+    long c = 0;
+    for (auto it = a.begin(); it != a.end(); ++it) {
+      c += b.contains(*it) ? 1 : 0;
+    }
+    printf("contains loop %ld, cost: %ld\n", c, (getTickCount() - start));
+
+    start = getTickCount();
+    c = a.intersectionSize(&b);
+    printf("intersectionSize %ld, cost: %ld\n", c, (getTickCount() - start));
+
+    start = getTickCount();
+    c = a.intersectWith(&b);
+    printf("intersectWith removed %ld, %ld, cost: %ld\n", c, a.size(),
+           (getTickCount() - start));
+
+    T x(false);
+    start = getTickCount();
+    c = x.symmetricDifference(&a, &b);
+    printf("symmetricDifference %ld, cost: %ld\n", c, (getTickCount() - start));
+  }
+
+  void prof_reserve(bool cocurrent) {
+    // 按预期个数预先扩容（ExpectedSize）与逐次翻倍的 add 比较
+    printf("==== test %s reserve (cocurrent=%d)...\n", m_name.c_str(),
+           cocurrent);
+    for (int reserved = 0; reserved < 2; reserved++) {
+      time_t start = getTickCount();
+      T *s = reserved ? new T(cocurrent, fastset::ExpectedSize(MAX_COUNT))
+                      : new T(cocurrent);
+      time_t reserveCost = getTickCount() - start;
+      for (int i = 0; i < MAX_COUNT; i++) {
+        s->add(makeValue(_dummy, i));
+      }
+      printf("%s add %d, %ld, cost: %ld (reserve: %ld)\n",
+             reserved ? "reserved" : "default", MAX_COUNT, s->size(),
+             (getTickCount() - start), reserveCost);
+      delete s;
+    }
+  }
+
+  void prof_add_all(int srcPartitionBits) {
+    // 分区数不同时的 addAll（按保存的 hashCode 定位分区）与按迭代器重新插入
+    printf("==== test %s addAll (srcPartitionBits=%d)...\n", m_name.c_str(),
+           srcPartitionBits);
+    T src(false, srcPartitionBits);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      src.add(makeValue(_dummy, i));
+    }
+
+    T s1(false);
+    time_t start = getTickCount();
+    long n = s1.addAll(src.begin(), src.end());
+    printf("addAll by iterator %ld, cost: %ld\n", n, (getTickCount() - start));
+
+    T s2(false);
+    start = getTickCount();
+    n = s2.addAll(&src);
+    printf("addAll %ld, cost: %ld\n", n, (getTickCount() - start));
+  }
+
+  void prof_compact(int keepEvery) {
+    // 删除大部分数据（每 keepEvery 个保留一个）后收缩，对比内存及查询耗时
+    printf("==== test %s compact (keepEvery=%d)...\n", m_name.c_str(),
+           keepEvery);
+    long rss = getRssKB();
+    T s(false);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+    for (int i = 0; i < MAX_COUNT; i++) {
+      if (i % keepEvery != 0) {
+        s.remove(makeValue(_dummy, i));
+      }
+    }
+    for (int round = 0; round < 2; round++) {
+      time_t start = getTickCount();
+      size_t released = round ? s.compact() : 0;
+      time_t compactCost = getTickCount() - start;
+      start = getTickCount();
+      long c = 0;
+      for (int i = 0; i < MAX_COUNT; i++) {
+        c += s.contains(makeValue(_dummy, i)) ? 1 : 0;
+      }
+      fastset::MemoryUsage usage = s.memoryUsage();
+      printf("%s size %ld, memoryUsage %ld KB (released %ld KB, cost: %ld), "
+             "rss %ld KB, contains %ld, cost: %ld\n",
+             round ? "compacted" : "removed", s.size(),
+             (long)usage.total() / 1024, (long)released / 1024, compactCost,
+             getRssKB() - rss, c, (getTickCount() - start));
+    }
+  }
+
+  void prof_parallel(int threads) {
+    // 比较单线程与多线程按分区并行的 addAll、clear 及析构前的释放
+    printf("==== test %s parallel (threads=%d)...\n", m_name.c_str(), threads);
+    T s(false, 6);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+
+    T *s1 = new T(false, 6);
+    time_t start = getTickCount();
+    s1->addAll(&s);
+    printf("addAll %ld, cost: %ld\n", s1->size(), (getTickCount() - start));
+
+    start = getTickCount();
+    s1->clear();
+    printf("clear cost: %ld\n", (getTickCount() - start));
+
+    start = getTickCount();
+    s1->addAllParallel(&s, threads);
+    printf("addAllParallel %ld, cost: %ld\n", s1->size(),
+           (getTickCount() - start));
+
+    start = getTickCount();
+    s1->clearParallel(threads);
+    printf("clearParallel cost: %ld\n", (getTickCount() - start));
+
+    s1->addAllParallel(&s, threads);
+    start = getTickCount();
+    s1->clearParallel(threads);
+    delete s1;
+    printf("clearParallel and delete cost: %ld\n", (getTickCount() - start));
+  }
+
+  void prof_snapshot(const char *filename) {
+    // 保存快照，并分别以读取及 mmap 的方式加载
+    printf("==== test %s snapshot...\n", m_name.c_str());
+    T s(false);
+    for (int i = 0; i < MAX_COUNT; i++) {
+      s.add(makeValue(_dummy, i));
+    }
+
+    time_t start = getTickCount();
+    ASSERT_RESULT(s.saveTo(filename), "saveTo should be true");
+    printf("saveTo %ld, cost: %ld\n", s.size(), (getTickCount() - start));
+
+    for (int mmap = 0; mmap < 2; mmap++) {
+      T s1(false);
+      start = getTickCount();
+      ASSERT_RESULT(s1.loadFrom(filename, mmap), "loadFrom should be true");
+      printf("loadFrom(mmap=%d) %ld, cost: %ld\n", mmap, s1.size(),
+             (getTickCount() - start));
+
+      start = getTickCount();
+      long c = 0;
+      for (int i = 0; i < MAX_COUNT; i++) {
+        c += s1.contains(makeValue(_dummy, i)) ? 1 : 0;
+      }
+      printf("contains %d, %ld, cost: %ld\n", MAX_COUNT, c,
+             (getTickCount() - start));
+    }
+    unlink(filename);
+  }
+
   void waitFinish(WorkerItem *sum, const WorkerItem *items, long start) {
     for (int i = 0; i < THREADS_COUNT; i++) {
       items[i].pthread->join();
@@ -342,6 +869,96 @@ public:
     }
   }
 
+  long removePending(T &s, std::vector<ValueT> &pending, long &err) {
+    // 批量删除，每个都应删除成功，再次删除应失败
+    size_t c = s.removeBatch(pending.data(), pending.size());
+    err += c == pending.size() ? 0 : 1;
+    if (!pending.empty()) {
+      err += s.remove(pending[0]) ? 1 : 0;
+    }
+    pending.clear();
+    return c;
+  }
+
+  void test_cocurrent_remove(int threads) {
+    // 多线程混合 add/remove/contains：前 1/4 的数据（常驻）在开始前加入且不
+    // 删除，任何时刻都应能查到；其余数据由各线程交错领取并加入，下标为奇数
+    // 的随后批量删除（removeBatch）。分区数少，删除与扩容及 filter 重建并发。
+    // 重复的数据只保留第一次出现的下标
+    int count = MAX_COUNT / 10;
+    int stable = count / 4;
+    printf("==== test %sConcurrent remove. total=%d  thread=%d\n",
+           m_name.c_str(), count, threads);
+    std::vector<bool> unique(count);
+    T seen(false);
+    for (int i = 0; i < count; i++) {
+      unique[i] = seen.add(makeValue(_dummy, i));
+    }
+
+    T s(true, 2);
+    s.setPrefilter(true);
+    for (int i = 0; i < stable; i++) {
+      if (unique[i]) {
+        s.add(makeValue(_dummy, i));
+      }
+    }
+
+    const int BATCH = 64;
+    volatile long errors = 0;
+    volatile long removed = 0;
+    std::vector<std::thread> workers;
+    time_t start = getTickCount();
+    for (int t = 0; t < threads; t++) {
+      workers.emplace_back([this, &s, &unique, &errors, &removed, t, threads,
+                            count, stable] {
+        long err = 0;
+        long n = 0;
+        std::vector<ValueT> pending;
+        for (int i = stable + t; i < count; i += threads) {
+          if (!unique[i]) {
+            continue;
+          }
+          ValueT v = makeValue(_dummy, i);
+          err += s.add(v) ? 0 : 1;
+          err += s.contains(v) ? 0 : 1;
+          int k = i % stable;
+          err += !unique[k] || s.contains(makeValue(_dummy, k)) ? 0 : 1;
+          if (i % 2 == 1) {
+            pending.push_back(v);
+          }
+          if (pending.size() == BATCH) {
+            n += removePending(s, pending, err);
+          }
+        }
+        n += removePending(s, pending, err);
+        __sync_fetch_and_add(&errors, err);
+        __sync_fetch_and_add(&removed, n);
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    time_t cost = getTickCount() - start;
+
+    // 剩余的应为全部常驻数据及下标为偶数的数据
+    long expected = 0;
+    for (int i = 0; i < count; i++) {
+      if (unique[i] && (i < stable || i % 2 == 0)) {
+        expected++;
+        errors += s.contains(makeValue(_dummy, i)) ? 0 : 1;
+      } else if (unique[i]) {
+        errors += s.contains(makeValue(_dummy, i)) ? 1 : 0;
+      }
+    }
+    s.debug_verify();
+    assert_result(errors == 0, "concurrent remove errors should be 0");
+    assert_result(s.size() == (size_t)expected,
+                  "size should equal to expected");
+    printf("final size: %ld (expected %ld), removed: %ld, errors: %ld, "
+           "cost: %ld\n",
+           s.size(), expected, removed, errors, cost);
+  }
+
   void dump_values(const char *msg, const LongHashset &s) {
     if (s.size() == 0) {
       printf("%s size=%ld\n", msg, s.size());
@@ -429,6 +1046,384 @@ public:
     return 0;
   }
 
+  void test_basic() {
+    // 跨多次扩容的 add/contains/remove/iterate/addAll/clear
+    printf("==== test %s basic...\n", m_name.c_str());
+    const int n = 200000;
+    initKeys(n * 2);
+    T s(false, 2);
+    long err = 0;
+    for (int i = 0; i < n; i++) {
+      err += s.add(makeKey(_dummy, i)) ? 0 : 1;
+    }
+    err += s.add(makeKey(_dummy, 0)) ? 1 : 0;
+    assert_result(err == 0, "add should be true only for new values");
+    assert_result(s.size() == (size_t)n, "size should equal to n");
+    for (int i = 0; i < n * 2; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for added values");
+
+    int count = 0;
+    for (auto it = s.begin(); it != s.end(); ++it) {
+      count++;
+    }
+    assert_result(count == n, "iterate should visit every value once");
+
+    for (int i = 1; i < n; i += 2) {
+      err += s.remove(makeKey(_dummy, i)) ? 0 : 1;
+      err += s.remove(makeKey(_dummy, i)) ? 1 : 0;
+    }
+    assert_result(err == 0, "remove should be true only once");
+    assert_result(s.size() == (size_t)n / 2, "size should equal to n / 2");
+    for (int i = 0; i < n; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i % 2 == 0) ? 0 : 1;
+    }
+    assert_result(err == 0, "removed values should not be found");
+
+    T s1(false, 4);
+    assert_result(s1.addAll(&s) == n / 2, "addAll should add n / 2");
+    assert_result(s1.size() == s.size(), "addAll should has same count");
+    assert_result(s1.addAll(&s1) == 0 && s1.size() == s.size(),
+                  "addAll itself should add nothing");
+    s.clear();
+    assert_result(s.size() == 0, "size should be 0 after clear");
+    assert_result(!s.contains(makeKey(_dummy, 0)),
+                  "contains should be false after clear");
+    assert_result(s.add(makeKey(_dummy, 0)), "add after clear should be true");
+  }
+
+  void test_cocurrent_find(int readers, int writers) {
+    // 读者反复查找常驻数据及从未加入的数据，同时写者加入新数据使分区多次扩容
+    printf("==== test %s concurrent find. readers=%d  writers=%d\n",
+           m_name.c_str(), readers, writers);
+    const int n = 100000;
+    initKeys(n * 3);
+    T s(true, 1);
+    for (int i = 0; i < n; i++) {
+      s.add(makeKey(_dummy, i));
+    }
+
+    volatile long errors = 0;
+    volatile int running = writers;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < writers; t++) {
+      workers.emplace_back([this, &s, &errors, &running, t, writers] {
+        long err = 0;
+        for (int i = n + t; i < n * 2; i += writers) {
+          err += s.add(makeKey(_dummy, i)) ? 0 : 1;
+        }
+        __sync_fetch_and_add(&errors, err);
+        __sync_fetch_and_sub(&running, 1);
+      });
+    }
+    for (int t = 0; t < readers; t++) {
+      workers.emplace_back([this, &s, &errors, &running, t] {
+        long err = 0;
+        do {
+          for (int i = t; i < n; i += 7) {
+            err += s.contains(makeKey(_dummy, i)) ? 0 : 1;
+            err += s.contains(makeKey(_dummy, n * 2 + i)) ? 1 : 0;
+          }
+        } while (running > 0);
+        __sync_fetch_and_add(&errors, err);
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    for (int i = 0; i < n * 3; i++) {
+      errors += s.contains(makeKey(_dummy, i)) == (i < n * 2) ? 0 : 1;
+    }
+    assert_result(errors == 0, "concurrent find errors should be 0");
+    assert_result(s.size() == (size_t)n * 2, "size should equal to 2n");
+    printf("final size: %ld, errors: %ld\n", s.size(), errors);
+  }
+
+  void test_spill(const char *dir) {
+    // 溢出模式：数据写入磁盘上的 run 后仍可查到、去重，合并后结果不变；
+    // 只能看到内存中数据的操作被拒绝
+    printf("==== test %s spill (dir=%s)...\n", m_name.c_str(), dir);
+    const int n = 200000;
+    initKeys(n * 2);
+    T s(false, 2);
+    assert_result(s.setMemoryBudget(1 << 20, dir),
+                  "setMemoryBudget should be true");
+    long err = 0;
+    for (int i = 0; i < n; i++) {
+      err += s.add(makeKey(_dummy, i)) ? 0 : 1;
+    }
+    for (int i = 0; i < n; i += 97) {
+      err += s.add(makeKey(_dummy, i)) ? 1 : 0;
+    }
+    assert_result(err == 0, "add should be true only for new values");
+    assert_result(s.getSpillRunCount() > 0, "values should be spilled");
+    assert_result(s.size() == (size_t)n, "size should equal to n");
+
+    s.mergeSpillRuns();
+    for (int i = 0; i < n * 2; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for added values");
+
+    T other(false, 4);
+    other.add(makeKey(_dummy, 0));
+    assert_result(!s.remove(makeKey(_dummy, 0)),
+                  "remove should be rejected in spill mode");
+    assert_result(s.contains(makeKey(_dummy, 0)),
+                  "rejected remove should keep the value");
+    assert_result(s.begin() == s.end(), "iterator should be rejected");
+    assert_result(s.intersectionSize(&other) == 0,
+                  "scanning a spilled set should be rejected");
+    assert_result(other.addAll(&s) == 0 && other.size() == 1,
+                  "addAll from a spilled set should be rejected");
+    assert_result(other.intersectionSize(&s) == 1,
+                  "a spilled set can be looked up");
+
+    s.clear();
+    assert_result(s.size() == 0, "size should be 0 after clear");
+    assert_result(!s.contains(makeKey(_dummy, 1)),
+                  "contains should be false after clear");
+  }
+
+  void test_out_of_range() {
+    // 紧凑节点：超出保存范围的数据不能加入，add 抛出异常，集合不变
+    printf("==== test %s out of range...\n", m_name.c_str());
+    T s(false, 2);
+    const ValueT big = (ValueT)1 << 32;
+    const ValueT max = big - 1;
+    assert_result(s.add(max), "add(2^32 - 1) should be true");
+    bool thrown = false;
+    try {
+      s.add(big + 1);
+    } catch (const std::out_of_range &) {
+      thrown = true;
+    }
+    assert_result(thrown, "add(2^32 + 1) should throw out_of_range");
+    ValueT keys[] = {1, big, 2};
+    thrown = false;
+    try {
+      s.addBatch(keys, 3);
+    } catch (const std::out_of_range &) {
+      thrown = true;
+    }
+    assert_result(thrown, "addBatch with 2^32 should throw out_of_range");
+    assert_result(s.size() == 2, "size should equal to 2");
+    assert_result(s.contains(1) && !s.contains(2),
+                  "values before the out-of-range one should be added");
+    assert_result(!s.contains(big + 1) && !s.contains(big),
+                  "out-of-range values should not be found");
+    assert_result(!s.remove(big + 1), "remove(2^32 + 1) should be false");
+    // 低 32 位相同的数据不能与已有的数据混淆
+    assert_result(!s.contains(big + max), "contains(2^33 - 1) should be false");
+    assert_result(s.contains(max), "contains(2^32 - 1) should be true");
+  }
+
+  void test_reserve() {
+    // 按预期个数预先扩容后加入数据，节点表不再增长；非空集合扩容时已有的
+    // 数据分裂到新的节点后仍可查到
+    printf("==== test %s reserve...\n", m_name.c_str());
+    const int n = 200000;
+    initKeys(n * 2);
+    T s(false, fastset::ExpectedSize(n), 2);
+    size_t nodeTable = s.memoryUsage().nodeTable;
+    long err = 0;
+    for (int i = 0; i < n; i++) {
+      err += s.add(makeKey(_dummy, i)) ? 0 : 1;
+    }
+    assert_result(err == 0, "add should be true for new values");
+    assert_result(s.size() == (size_t)n, "size should equal to n");
+    assert_result(s.memoryUsage().nodeTable == nodeTable,
+                  "node table should not grow after ExpectedSize");
+    for (int i = 0; i < n * 2; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for added values");
+
+    T s1(false, 2);
+    for (int i = 0; i < n / 10; i++) {
+      s1.add(makeKey(_dummy, i));
+    }
+    s1.reserve(n);
+    nodeTable = s1.memoryUsage().nodeTable;
+    for (int i = 0; i < n / 10; i++) {
+      err += s1.contains(makeKey(_dummy, i)) ? 0 : 1;
+    }
+    assert_result(err == 0, "values added before reserve should be found");
+    for (int i = n / 10; i < n; i++) {
+      err += s1.add(makeKey(_dummy, i)) ? 0 : 1;
+    }
+    assert_result(err == 0, "add should be true for new values");
+    assert_result(s1.size() == (size_t)n, "size should equal to n");
+    assert_result(s1.memoryUsage().nodeTable == nodeTable,
+                  "node table should not grow after reserve");
+    for (int i = 0; i < n * 2; i++) {
+      err += s1.contains(makeKey(_dummy, i)) == (i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for added values");
+  }
+
+  void test_compact() {
+    // 删除大部分数据后收缩：保留的数据仍可查到，删除的数据可以重新加入
+    printf("==== test %s compact...\n", m_name.c_str());
+    const int n = 200000;
+    initKeys(n * 2);
+    T s(false, 2);
+    for (int i = 0; i < n; i++) {
+      s.add(makeKey(_dummy, i));
+    }
+    for (int i = 0; i < n; i++) {
+      if (i % 10 != 0) {
+        s.remove(makeKey(_dummy, i));
+      }
+    }
+    size_t before = s.memoryUsage().total();
+    size_t released = s.compact(2);
+    assert_result(released > 0, "compact should release memory");
+    assert_result(s.memoryUsage().total() < before,
+                  "memoryUsage should decrease after compact");
+    assert_result(s.size() == (size_t)n / 10, "size should equal to n / 10");
+    long err = 0;
+    for (int i = 0; i < n * 2; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i < n && i % 10 == 0) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for kept values");
+
+    for (int i = 0; i < n; i++) {
+      err += s.add(makeKey(_dummy, i)) == (i % 10 != 0) ? 0 : 1;
+    }
+    assert_result(err == 0, "add should be true only for removed values");
+    assert_result(s.size() == (size_t)n, "size should equal to n");
+    for (int i = 0; i < n * 2; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true for re-added values");
+  }
+
+  void test_for_each_partition() {
+    // 并行处理各分区：每个分区只处理一次，调用线程也参与；fn 抛出的异常
+    // 在全部线程结束后重新抛出
+    printf("==== test %s forEachPartition...\n", m_name.c_str());
+    T s(false, 4);
+    int count = s.getPartitionCount();
+    std::vector<int> visits(count, 0);
+    s.forEachPartition(4, [&visits](int i) {
+      __sync_fetch_and_add(&visits[i], 1);
+    });
+    long err = 0;
+    for (int i = 0; i < count; i++) {
+      err += visits[i] == 1 ? 0 : 1;
+    }
+    assert_result(err == 0, "each partition should be visited once");
+
+    bool thrown = false;
+    try {
+      s.forEachPartition(4, [count](int i) {
+        if (i == count / 2) {
+          throw std::runtime_error("partition failed");
+        }
+      });
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert_result(thrown, "exception in fn should be rethrown");
+  }
+
+  void test_prefilter_churn(bool cocurrent) {
+    // 大小稳定、反复删除及加入的集合：删除较多时重建 filter，替换下的 filter
+    // 需要及时释放，占用的内存不随轮数增长
+    printf("==== test %s prefilter churn (cocurrent=%d)...\n", m_name.c_str(),
+           cocurrent);
+    const int n = 50000;
+    const int rounds = 20;
+    initKeys(n / 2 * rounds + n);
+    T s(cocurrent, 2);
+    s.setPrefilter(true);
+    for (int i = 0; i < n; i++) {
+      s.add(makeKey(_dummy, i));
+    }
+    long err = 0;
+    size_t limit = 0;
+    size_t overhead = 0;
+    for (int r = 0; r < rounds; r++) {
+      // 删除最早加入的 n/2 个，再加入 n/2 个新的数据
+      int first = r * (n / 2);
+      for (int i = first; i < first + n / 2; i++) {
+        err += s.remove(makeKey(_dummy, i)) ? 0 : 1;
+      }
+      for (int i = first + n; i < first + n + n / 2; i++) {
+        err += s.add(makeKey(_dummy, i)) ? 0 : 1;
+      }
+      overhead = s.memoryUsage().overhead;
+      if (r == 1) {
+        limit = overhead * 3 / 2;
+      }
+    }
+    assert_result(err == 0, "remove and add should be true");
+    assert_result(s.size() == (size_t)n, "size should equal to n");
+    printf("overhead: %ld KB (limit %ld KB)\n", (long)overhead / 1024,
+           (long)limit / 1024);
+    assert_result(overhead <= limit, "memoryUsage should stay bounded");
+    int live = n / 2 * rounds;
+    for (int i = 0; i < live + n; i++) {
+      err += s.contains(makeKey(_dummy, i)) == (i >= live) ? 0 : 1;
+    }
+    assert_result(err == 0, "contains should be true only for live values");
+  }
+
+  void test_set_algebra() {
+    // 分区数不同的集合间的运算：a 为 [0, n)，b 为 [n/2, n*3/2)
+    printf("==== test %s set algebra...\n", m_name.c_str());
+    const int n = 100000;
+    initKeys(n * 2);
+    T a(false, 1), b(false, 3);
+    for (int i = 0; i < n; i++) {
+      a.add(makeKey(_dummy, i));
+      b.add(makeKey(_dummy, i + n / 2));
+    }
+    const size_t half = n / 2;
+    assert_result(a.intersectionSize(&b) == half &&
+                      b.intersectionSize(&a) == half,
+                  "intersectionSize should equal to n / 2");
+    assert_result(a.differenceSize(&b) == half && b.differenceSize(&a) == half,
+                  "differenceSize should equal to n / 2");
+    assert_result(a.symmetricDifferenceSize(&b) == (size_t)n,
+                  "symmetricDifferenceSize should equal to n");
+
+    long err = 0;
+    T c(false, 2);
+    c.addAll(&a);
+    assert_result(c.intersectWith(&b) == half,
+                  "intersectWith should remove n / 2");
+    for (int i = 0; i < n * 2; i++) {
+      err += c.contains(makeKey(_dummy, i)) == (i >= n / 2 && i < n) ? 0 : 1;
+    }
+    assert_result(err == 0, "intersectWith should keep [n/2, n)");
+
+    T d(false, 4);
+    d.addAll(&a);
+    assert_result(d.subtract(&b) == half, "subtract should remove n / 2");
+    for (int i = 0; i < n * 2; i++) {
+      err += d.contains(makeKey(_dummy, i)) == (i < n / 2) ? 0 : 1;
+    }
+    assert_result(err == 0, "subtract should keep [0, n/2)");
+
+    T x(false, 2);
+    assert_result(x.symmetricDifference(&a, &b) == (size_t)n,
+                  "symmetricDifference should add n");
+    // 原地计算：b 中的数据在 a 中存在则删除，否则加入
+    assert_result(a.symmetricDifference(&a, &b) == half,
+                  "symmetricDifference in place should add n / 2");
+    assert_result(a.size() == (size_t)n, "size should equal to n");
+    for (int i = 0; i < n * 2; i++) {
+      bool expected = i < n / 2 || (i >= n && i < n * 3 / 2);
+      err += x.contains(makeKey(_dummy, i)) == expected ? 0 : 1;
+      err += a.contains(makeKey(_dummy, i)) == expected ? 0 : 1;
+    }
+    assert_result(err == 0, "symmetricDifference should keep values only in "
+                            "one set");
+  }
+
   void prof_unordered_set() {
     printf("==== test unordered_set...\n");
 
@@ -560,6 +1555,68 @@ public:
         printf("\n");
       }
     }
+
+    prof_hash_policy<CalcHash>("CalcHash");
+    prof_hash_policy<fastset::MixHash>("MixHash");
+    prof_hash_policy<fastset::Crc32cHash>("Crc32cHash");
+  }
+
+  // hash 策略的吞吐量及分布。结构化 id：高位为类型（label），低位为序号
+  template <class Hasher> void prof_hash_policy(const char *name) {
+    time_t start = getTickCount();
+    long h = 0;
+    int t = 100000000;
+    for (int i = 0; i < t; i++) {
+      h += Hasher::get(makeValue(_dummy, i));
+    }
+    printf("%s %d, %ld, cost: %ld\n", name, t, h, (getTickCount() - start));
+
+    const int n = 1 << 22;
+    stat_hash_codes<Hasher>(name, "seq", n,
+                            [](int i) { return (uint64_t)i; });
+    stat_hash_codes<Hasher>(name, "label<<48|seq", n, [](int i) {
+      return ((uint64_t)(i & 0xf) << 48) | (uint64_t)(i >> 4);
+    });
+    stat_hash_codes<Hasher>(name, "seq<<32|seq", n, [](int i) {
+      return ((uint64_t)i << 32) | (uint64_t)i;
+    });
+  }
+
+  template <class Hasher, class KeyGen>
+  void stat_hash_codes(const char *name, const char *keys, int n,
+                       KeyGen keyGen) {
+    // 所有 key 互不相同：统计 hashCode 冲突数、分区及分区内节点的均衡性
+    const int partCount = 64;
+    const int tableSize = 1 << 16;
+    std::vector<uint32_t> codes(n);
+    std::vector<int> partitions(partCount, 0);
+    std::vector<int> table(tableSize, 0);
+    for (int i = 0; i < n; i++) {
+      codes[i] = Hasher::get(keyGen(i));
+      int partIndex = CalcHash::getShort(codes[i]) % partCount;
+      partitions[partIndex]++;
+      if (partIndex == 0) {
+        table[codes[i] % tableSize]++;
+      }
+    }
+    std::sort(codes.begin(), codes.end());
+    long collisions = n - (std::unique(codes.begin(), codes.end()) -
+                           codes.begin());
+
+    int minPart = *std::min_element(partitions.begin(), partitions.end());
+    int maxPart = *std::max_element(partitions.begin(), partitions.end());
+    double total = 0;
+    double square = 0;
+    for (int k = 0; k < tableSize; k++) {
+      total += table[k];
+      square += (double)table[k] * table[k];
+    }
+    double avg = total / tableSize;
+    double std = sqrt(square / tableSize - avg * avg);
+    printf("%s [%s] collisions=%ld, partition min=%d, max=%d, "
+           "part_0 avg=%.3f, std=%.3f, max=%d\n",
+           name, keys, collisions, minPart, maxPart, avg, std,
+           *std::max_element(table.begin(), table.end()));
   }
 
   void test_spinlock_single() {
@@ -581,40 +1638,171 @@ public:
     waitFinish(nullptr, workers, 0);
   }
 
-  void test_spinlock_m() {
-    const int LOCKCOUNT = 10;
-    uint32_t *locks = new uint32_t[LOCKCOUNT];
-    struct WorkerItem workers[THREADS_COUNT] = {0};
-    int start = getTickCount();
-    for (int i = 0; i < THREADS_COUNT; i++) {
-      workers[i].pthread = new std::thread([&locks, i] {
-        char name[256]{0};
-        for (int j = 0; j < 10000; j++) {
-          int r = rand() % LOCKCOUNT;
-          sprintf(name, "t_%d_%d", i, r);
-          usleep(1000);
-          SpinnedLock::doLock(locks + r, name);
-          usleep(100);
-          SpinnedLock::doUnlock(locks + r, name);
+  // 原来的自旋锁（不 pause，每 512 次 usleep），与 SpinnedLock 对比用
+  struct SleepSpinLock {
+    volatile uint32_t value{0};
+
+    void lock() {
+      int n = 0;
+      while (__sync_lock_test_and_set(&value, 1) != 0) {
+        if ((++n & 0x1ff) == 0) {
+          usleep(10);
+        }
+      }
+    }
+
+    void unlock() { __sync_lock_release(&value); }
+  };
+
+  // 节点上使用的带版本号的锁
+  struct SeqLock {
+    volatile uint32_t value{0};
+
+    void lock() { SpinnedLock::doSeqLock(&value); }
+
+    void unlock() { SpinnedLock::doSeqUnlock(&value); }
+  };
+
+  template <class Lock>
+  void prof_lock(const char *name, int threads, int lockCount) {
+    struct alignas(64) Slot {
+      Lock lock;
+      long count{0};
+    };
+    const int LOOPS = 2000000;
+    std::unique_ptr<Slot[]> slots(new Slot[lockCount]);
+#ifdef _LOG_FOR_METRICS
+    SpinnedLock::resetStats();
+#endif
+    std::vector<std::thread> workers;
+    time_t start = getTickCount();
+    for (int t = 0; t < threads; t++) {
+      workers.emplace_back([&slots, t, threads, lockCount, LOOPS]() {
+        uint32_t r = t * 2654435761u + 1;
+        for (int j = 0; j < LOOPS / threads; j++) {
+          r ^= r << 13;
+          r ^= r >> 17;
+          r ^= r << 5;
+          Slot &slot = slots[r % lockCount];
+          slot.lock.lock();
+          slot.count++; // 临界区很短，与节点上的 add 相近
+          slot.lock.unlock();
         }
       });
     }
-    // 主线程顺序扫描
-    char name[256]{0};
-    for (int i = 0; i < 10000; i++) {
-      int r = i % LOCKCOUNT;
-      sprintf(name, "m_%d", r);
-      SpinnedLock::doLock(locks + r, name);
-      usleep(300);
-      SpinnedLock::doUnlock(locks + r, name);
+    for (auto &w : workers) {
+      w.join();
+    }
+    long total = 0;
+    for (int i = 0; i < lockCount; i++) {
+      total += slots[i].count;
     }
+    printf("%s: count %ld (expect %d), cost: %ld\n", name, total,
+           LOOPS / threads * threads, (getTickCount() - start));
+#ifdef _LOG_FOR_METRICS
+    SpinnedLock::Stats stats = SpinnedLock::getStats();
+    printf("  contended %lu, spins %lu, waits %lu, wakes %lu\n",
+           stats.contended, stats.spins, stats.waits, stats.wakes);
+#endif
+  }
 
-    waitFinish(nullptr, workers, 0);
+  void test_spinlock_m(int threads, int lockCount) {
+    // 锁竞争：threads 个线程随机取 lockCount 个锁之一，比较几种锁
+    printf("==== test spinlock (threads=%d, locks=%d)...\n", threads,
+           lockCount);
+    prof_lock<std::mutex>("std::mutex", threads, lockCount);
+    prof_lock<SleepSpinLock>("usleep spin", threads, lockCount);
+    prof_lock<SpinnedLock>("SpinnedLock", threads, lockCount);
+    prof_lock<SeqLock>("SpinnedLock(seq)", threads, lockCount);
   }
 };
 
 using TestLongHashset = TestHashset<LongHashset, uint64_t>;
 using TestSliceHashset = TestHashset<SliceHashset, Slice>;
+using TestSwissLongHashset = TestHashset<SwissLongHashset, uint64_t>;
+using TestCompactLongHashset = TestHashset<CompactLongHashset, uint64_t>;
+
+void prof_buffer_manager(int threads, int arenaCount) {
+  // 多线程申请/释放节点扩展内存的竞争：arenaCount 为 1 时所有线程共用一个锁
+  printf("==== test buffer manager (threads=%d, arenas=%d)...\n", threads,
+         arenaCount);
+  const int loops = 1000000;
+  const int live = 256;
+  fastset::CBufferManager mgr(true, arenaCount);
+  std::vector<std::thread> workers;
+  long start = getTickCount();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&mgr, t]() {
+      unsigned char *bufs[live]{nullptr};
+      int sizes[live]{0};
+      for (int i = 0; i < loops; i++) {
+        int k = i % live;
+        if (bufs[k] != nullptr) {
+          mgr.dealloc(bufs[k], sizes[k]);
+        }
+        sizes[k] = 12 << ((i + t) % 6); // 与 FixedSizeHashNode 的扩容相同
+        bufs[k] = mgr.alloc(sizes[k]);
+        bufs[k][0] = (unsigned char)i;
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  printf("alloc %ld, cost: %ld\n", (long)threads * loops,
+         getTickCount() - start);
+}
+
+void test_numa_node_list() {
+  // /sys/devices/system/node/online 的格式：逗号分隔的节点号或范围
+  printf("==== test numa node list...\n");
+  using Allocator = fastset::CPageAllocator;
+  assert_result(Allocator::parseNodeList("0\n") == 0x1, "\"0\" is node 0");
+  assert_result(Allocator::parseNodeList("0-3\n") == 0xf, "\"0-3\" is 0~3");
+  assert_result(Allocator::parseNodeList("0,2\n") == 0x5,
+                "\"0,2\" is node 0 and 2");
+  assert_result(Allocator::parseNodeList("0-1,3\n") == 0xb,
+                "\"0-1,3\" is node 0, 1 and 3");
+  assert_result(Allocator::parseNodeList("1,4-5,63-70\n") ==
+                    (0x32ULL | (1ULL << 63)),
+                "node ids from 64 on should be ignored");
+  assert_result(Allocator::parseNodeList("") == 0, "empty list has no node");
+}
+
+void test_behaviors() {
+  // 各种节点类型的行为测试，与加载的数据无关
+  test_numa_node_list();
+
+  TestSwissLongHashset swiss("SwissLong");
+  swiss.test_basic();
+  swiss.test_cocurrent_find(4, 4);
+  swiss.test_set_algebra();
+  swiss.test_reserve();
+  swiss.test_compact();
+
+  TestLongHashset test("Long");
+  test.test_basic();
+  test.test_cocurrent_find(8, 4);
+  test.test_spill("./output");
+  test.test_set_algebra();
+  test.test_for_each_partition();
+  test.test_prefilter_churn(false);
+  test.test_prefilter_churn(true);
+  test.test_reserve();
+  test.test_compact();
+
+  TestSliceHashset slice("Slice");
+  slice.test_cocurrent_find(8, 4);
+  slice.test_set_algebra();
+  slice.test_reserve();
+  slice.test_compact();
+
+  TestCompactLongHashset compact("CompactLong");
+  compact.test_out_of_range();
+  compact.test_set_algebra();
+  compact.test_reserve();
+  compact.test_compact();
+}
 
 void test_mem() {
   printf("test mem ...\n");
@@ -638,9 +1826,12 @@ int main() {
 
   TestLongHashset test("Long");
   // TestSliceHashset test("Slice");
+  // TestSwissLongHashset test("SwissLong"); // 开放寻址分区，与 Long 对比
+  // TestCompactLongHashset test("CompactLong"); // 紧凑节点，与 Long 对比
 
   // test.test_spinlock_single();
-  // test.test_spinlock_m();
+  // test.test_spinlock_m(THREADS_COUNT, 1);
+  // test.test_spinlock_m(THREADS_COUNT, 64);
 
   // test.initBuffer(true);    // random
 
@@ -648,7 +1839,9 @@ int main() {
 
   // test.test_hashCode();
   test.test_feature();
+  test_behaviors();
   test.test_thread_multi_pass(false);   // true for addExclusive test
+  test.test_cocurrent_remove(THREADS_COUNT);
   test.prof_hashset("HashSet", false);
   test.prof_hashset("CocurrentHashset", true);
 